@@ -0,0 +1,687 @@
+/*
+ * benchmarks.cpp
+ *
+ * Copyright 2002-2019 Vesa Halttunen
+ *
+ * This file is part of Tutka.
+ *
+ * Tutka is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tutka is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tutka; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <QtTest>
+#include <QTemporaryDir>
+#include <cmath>
+#include <cstring>
+#include <sys/time.h>
+#include <QDomDocument>
+#include "block.h"
+#include "playseq.h"
+#include "song.h"
+#include "player.h"
+#include "buffermidi.h"
+#include "buffermidiinterface.h"
+#include "conversion.h"
+#include "smf.h"
+#include "scheduler.h"
+#include "clockfollower.h"
+#include "latencyhistogram.h"
+#include "loopbackmidi.h"
+
+// Exports a song to a file in a thread of its own
+class ExportThread : public QThread
+{
+public:
+    ExportThread(Song *song, Player::ExportOutputs exportOutputs, const QString &path) : song(song), exportOutputs(exportOutputs), path(path), saved(false) { }
+
+    virtual void run()
+    {
+        SMF *smf = songToSMF(song, exportOutputs);
+        saved = smf->save(path);
+        delete smf;
+    }
+
+    Song *song;
+    Player::ExportOutputs exportOutputs;
+    QString path;
+    bool saved;
+};
+
+class Benchmarks : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void playSong_data();
+    void playSong();
+    void denseOutput_data();
+    void denseOutput();
+    void timelineScan_data();
+    void timelineScan();
+
+    void blockCopy_data();
+    void blockCopy();
+    void blockPaste_data();
+    void blockPaste();
+    void blockTranspose_data();
+    void blockTranspose();
+    void blockExpandShrink_data();
+    void blockExpandShrink();
+    void blockInsertLine_data();
+    void blockInsertLine();
+    void blockRead_data();
+    void blockRead();
+    void sparseBlockSave();
+
+    void songSave();
+    void songLoad();
+    void concurrentExport();
+
+    void monotonicSchedulerDrift();
+    void tickDeadlines();
+    void clockFollowerJitter();
+    void thruLatency();
+
+private:
+    // Adds the block sizes used by the block benchmarks
+    static void blockSizes();
+
+    // Creates a block filled with notes and commands; the same seed always creates the same contents
+    static Block *createBlock(int tracks, int lines, int commandPages, unsigned int seed);
+
+    // Creates a song playing the given number of filled blocks in sequence
+    static Song *createSong(int blocks, int tracks, int lines, int commandPages);
+
+    QTemporaryDir directory;
+    // A large song for the load and save benchmarks
+    Song *largeSong;
+};
+
+void Benchmarks::initTestCase()
+{
+    QVERIFY(directory.isValid());
+    largeSong = createSong(16, 64, 1024, 4);
+}
+
+void Benchmarks::cleanupTestCase()
+{
+    delete largeSong;
+}
+
+void Benchmarks::playSong_data()
+{
+    QTest::addColumn<int>("tracks");
+    QTest::addColumn<int>("lines");
+    QTest::addColumn<int>("commandPages");
+
+    QTest::newRow("4 tracks, 64 lines, 1 command page") << 4 << 64 << 1;
+    QTest::newRow("16 tracks, 256 lines, 1 command page") << 16 << 256 << 1;
+    QTest::newRow("16 tracks, 256 lines, 4 command pages") << 16 << 256 << 4;
+    QTest::newRow("64 tracks, 256 lines, 1 command page") << 64 << 256 << 1;
+    QTest::newRow("64 tracks, 1024 lines, 4 command pages") << 64 << 1024 << 4;
+    QTest::newRow("128 tracks, 256 lines, 1 command page") << 128 << 256 << 1;
+    QTest::newRow("256 tracks, 256 lines, 1 command page") << 256 << 256 << 1;
+}
+
+void Benchmarks::playSong()
+{
+    QFETCH(int, tracks);
+    QFETCH(int, lines);
+    QFETCH(int, commandPages);
+
+    Song *song = createSong(4, tracks, lines, commandPages);
+
+    QBENCHMARK {
+        BufferMIDI midi;
+        Player player(&midi, song, true);
+        QMetaObject::invokeMethod(&player, "init");
+        player.playWithoutScheduling(Player::ExportOutputsSingle);
+        QCOMPARE(player.ticksPlayed(), 4u * lines * song->ticksPerLine());
+    }
+
+    delete song;
+}
+
+void Benchmarks::denseOutput_data()
+{
+    QTest::addColumn<int>("tracks");
+
+    QTest::newRow("16 tracks") << 16;
+    QTest::newRow("64 tracks") << 64;
+}
+
+void Benchmarks::denseOutput()
+{
+    QFETCH(int, tracks);
+
+    // Every cell plays a note and changes a controller on every command page, so each tick writes as much as it can
+    const int lines = 256;
+    Song *song = createSong(1, tracks, lines, 4);
+    Block *block = song->block(0);
+    for (int line = 0; line < lines; line++) {
+        for (int track = 0; track < tracks; track++) {
+            block->setNoteFull(line, track, 36 + (line + track) % 48, 1);
+            for (int commandPage = 0; commandPage < 4; commandPage++) {
+                block->setCommandFull(line, track, commandPage, Player::CommandMidiControllers + commandPage, (line + track + commandPage) % 128);
+            }
+        }
+    }
+
+    int bytes = 0;
+    QBENCHMARK {
+        BufferMIDI midi;
+        Player player(&midi, song, true);
+        QMetaObject::invokeMethod(&player, "init");
+        player.playWithoutScheduling(Player::ExportOutputsSingle);
+        bytes = static_cast<BufferMIDIInterface *>(midi.output(0).data())->data().size();
+    }
+    QVERIFY(bytes > 0);
+    qInfo("Dense output: %d bytes of MIDI per song", bytes);
+
+    delete song;
+}
+
+void Benchmarks::timelineScan_data()
+{
+    QTest::addColumn<bool>("compiled");
+
+    QTest::newRow("compiled timeline") << true;
+    QTest::newRow("every cell") << false;
+}
+
+void Benchmarks::timelineScan()
+{
+    QFETCH(bool, compiled);
+
+    // A block with room for more than is used, like most songs: a quarter of the tracks and command pages are filled
+    const int tracks = 64, lines = 1024;
+    Block block(tracks, lines, 8);
+    Block *used = createBlock(tracks / 4, lines, 2, 1);
+    block.paste(used, 0, 0);
+    delete used;
+
+    // Find the notes and commands of every line from the compiled timeline the player walks
+    // or by reading every track and command page of the block like the player used to
+    unsigned int expected = 0, found = 0;
+    for (int line = 0; line < lines; line++) {
+        for (int track = 0; track < tracks / 4; track++) {
+            expected += block.note(line, track) != 0 ? 1 : 0;
+            for (int commandPage = 0; commandPage < 2; commandPage++) {
+                expected += block.command(line, track, commandPage) != 0 || block.commandValue(line, track, commandPage) != 0 ? 1 : 0;
+            }
+        }
+    }
+    QVERIFY(expected > 0);
+
+    QBENCHMARK {
+        found = 0;
+        if (compiled) {
+            QSharedPointer<const BlockTimeline> timeline = block.timeline();
+            for (int line = 0; line < lines; line++) {
+                const BlockTimeline::Line &compiledLine = timeline->line(line);
+                for (int cell = 0; cell < compiledLine.cells.count(); cell++) {
+                    found += compiledLine.cells.at(cell).note != 0 ? 1 : 0;
+                }
+                found += compiledLine.commands.count();
+            }
+        } else {
+            for (int line = 0; line < lines; line++) {
+                for (int track = 0; track < tracks; track++) {
+                    found += block.note(line, track) != 0 ? 1 : 0;
+                    for (int commandPage = 0; commandPage < 8; commandPage++) {
+                        found += block.command(line, track, commandPage) != 0 || block.commandValue(line, track, commandPage) != 0 ? 1 : 0;
+                    }
+                }
+            }
+        }
+    }
+
+    QCOMPARE(found, expected);
+}
+
+void Benchmarks::blockSizes()
+{
+    QTest::addColumn<int>("tracks");
+    QTest::addColumn<int>("lines");
+
+    QTest::newRow("16 tracks, 256 lines") << 16 << 256;
+    QTest::newRow("64 tracks, 1024 lines") << 64 << 1024;
+}
+
+void Benchmarks::blockCopy_data()
+{
+    blockSizes();
+}
+
+void Benchmarks::blockCopy()
+{
+    QFETCH(int, tracks);
+    QFETCH(int, lines);
+
+    Block *block = createBlock(tracks, lines, 4, 1);
+
+    QBENCHMARK {
+        delete block->copy(0, 0, tracks - 1, lines - 1);
+    }
+
+    delete block;
+}
+
+void Benchmarks::blockPaste_data()
+{
+    blockSizes();
+}
+
+void Benchmarks::blockPaste()
+{
+    QFETCH(int, tracks);
+    QFETCH(int, lines);
+
+    Block *block = createBlock(tracks, lines, 4, 1);
+    Block *from = createBlock(tracks, lines, 4, 2);
+
+    QBENCHMARK {
+        block->paste(from, 0, 0);
+    }
+
+    delete from;
+    delete block;
+}
+
+void Benchmarks::blockTranspose_data()
+{
+    blockSizes();
+}
+
+void Benchmarks::blockTranspose()
+{
+    QFETCH(int, tracks);
+    QFETCH(int, lines);
+
+    Block *block = createBlock(tracks, lines, 4, 1);
+
+    // Transposing up and down keeps the notes in range however many times the benchmark runs
+    int halfNotes = 1;
+    QBENCHMARK {
+        block->transpose(-1, halfNotes, 0, 0, tracks - 1, lines - 1);
+        halfNotes = -halfNotes;
+    }
+
+    delete block;
+}
+
+void Benchmarks::blockExpandShrink_data()
+{
+    blockSizes();
+}
+
+void Benchmarks::blockExpandShrink()
+{
+    QFETCH(int, tracks);
+    QFETCH(int, lines);
+
+    Block *block = createBlock(tracks, lines, 4, 1);
+
+    QBENCHMARK {
+        block->expandShrink(2, 0, 0, tracks - 1, lines - 1, false);
+    }
+
+    delete block;
+}
+
+void Benchmarks::blockInsertLine_data()
+{
+    blockSizes();
+}
+
+void Benchmarks::blockInsertLine()
+{
+    QFETCH(int, tracks);
+    QFETCH(int, lines);
+
+    Block *block = createBlock(tracks, lines, 4, 1);
+
+    QBENCHMARK {
+        block->insertLine(0);
+    }
+
+    delete block;
+}
+
+void Benchmarks::blockRead_data()
+{
+    blockSizes();
+}
+
+void Benchmarks::blockRead()
+{
+    QFETCH(int, tracks);
+    QFETCH(int, lines);
+
+    Block *block = createBlock(tracks, lines, 4, 1);
+
+    // Read every cell on every command page line by line like painting the tracker and compiling the timeline do
+    unsigned int sum = 0;
+    QBENCHMARK {
+        for (int line = 0; line < lines; line++) {
+            for (int track = 0; track < tracks; track++) {
+                sum += block->note(line, track) + block->instrument(line, track);
+                for (int commandPage = 0; commandPage < 4; commandPage++) {
+                    sum += block->command(line, track, commandPage) + block->commandValue(line, track, commandPage);
+                }
+            }
+        }
+    }
+    QVERIFY(sum > 0);
+
+    delete block;
+}
+
+void Benchmarks::sparseBlockSave()
+{
+    // A long block with a few hundred notes in a couple of passages
+    const int lines = 4096;
+    Block block(64, lines, 8);
+    for (int note = 0; note < 300; note++) {
+        int line = (note < 150 ? 256 : 2048) + note % 150;
+        block.setNoteFull(line, note % 64, 36 + note % 48, 1);
+        block.setCommandFull(line, note % 64, note % 8, Player::CommandVelocity, 100);
+    }
+
+    // Only the chunks with notes are allocated
+    int allocated = 0;
+    for (int line = 0; line < lines; line += Block::CHUNK_LINES) {
+        allocated += block.isLineAllocated(line) ? 1 : 0;
+    }
+    QVERIFY2(allocated <= 2 * (150 / Block::CHUNK_LINES + 2), qPrintable(QString("%1 chunks allocated").arg(allocated)));
+
+    QBENCHMARK {
+        QDomDocument document;
+        QDomElement element = document.createElement("blocks");
+        document.appendChild(element);
+        block.save(0, element, document);
+    }
+}
+
+void Benchmarks::songSave()
+{
+    QString path = directory.filePath("save.tutka");
+
+    QBENCHMARK {
+        largeSong->save(path);
+    }
+
+    QVERIFY(QFile::exists(path));
+}
+
+void Benchmarks::songLoad()
+{
+    QString path = directory.filePath("load.tutka");
+    largeSong->save(path);
+
+    QBENCHMARK {
+        Song *song = loadSong(path);
+        QCOMPARE(song->blocks(), largeSong->blocks());
+        delete song;
+    }
+}
+
+void Benchmarks::concurrentExport()
+{
+    // Commands changing the tempo and the volumes make the players keep state of their own
+    Song *song = createSong(4, 16, 256, 4);
+    for (int number = 0; number < 4; number++) {
+        Block *block = song->block(number);
+        block->setCommandFull(0, 0, 3, Player::CommandTempo, 100 + number * 20);
+        block->setCommandFull(64, 1, 3, Player::CommandTrackVolume, 0x80 + 32 * number);
+        block->setCommandFull(128, 2, 3, Player::CommandInstrumentVolume, 64 + number);
+    }
+    unsigned int tempo = song->tempo();
+
+    QString referencePath = directory.filePath("reference.mid");
+    SMF *reference = songToSMF(song, Player::ExportOutputsPerInstrument);
+    QVERIFY(reference->save(referencePath));
+    delete reference;
+    QFile referenceFile(referencePath);
+    QVERIFY(referenceFile.open(QIODevice::ReadOnly));
+    QByteArray expected = referenceFile.readAll();
+
+    // Exports running at the same time produce what a single export does and leave the song untouched
+    QList<ExportThread *> threads;
+    for (int thread = 0; thread < 4; thread++) {
+        threads.append(new ExportThread(song, Player::ExportOutputsPerInstrument, directory.filePath(QString("concurrent%1.mid").arg(thread))));
+    }
+    foreach (ExportThread *thread, threads) {
+        thread->start();
+    }
+    foreach (ExportThread *thread, threads) {
+        thread->wait();
+        QVERIFY(thread->saved);
+        QFile file(thread->path);
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        QVERIFY2(file.readAll() == expected, qPrintable(thread->path));
+    }
+    qDeleteAll(threads);
+
+    QCOMPARE(song->tempo(), tempo);
+    delete song;
+}
+
+void Benchmarks::monotonicSchedulerDrift()
+{
+    Scheduler *scheduler = NULL;
+    foreach (Scheduler *candidate, Scheduler::schedulers()) {
+        if (strcmp(candidate->name(), "Monotonic") == 0) {
+            scheduler = candidate;
+        }
+    }
+    if (scheduler == NULL) {
+        QSKIP("The monotonic scheduler is not available on this platform");
+    }
+
+    // 240 ticks at 600 BPM take one second
+    const unsigned int tempo = 600;
+    const qint64 ticks = 240;
+
+    struct timeval startTime;
+    gettimeofday(&startTime, NULL);
+    QElapsedTimer timer;
+    timer.start();
+    scheduler->start(startTime);
+    for (qint64 tick = 0; tick < ticks; tick++) {
+        scheduler->waitForTick(tempo, false);
+    }
+    qint64 elapsed = timer.nsecsElapsed();
+    scheduler->stop();
+
+    // The deadlines are absolute so only the lateness of the last tick shows, not the sum of all of them
+    qint64 drift = elapsed - Scheduler::tickTime(ticks, tempo);
+    QVERIFY2(drift >= 0, qPrintable(QString("Woke up %1 ns early").arg(-drift)));
+    QVERIFY2(drift < 2000000, qPrintable(QString("Drifted %1 ns in %2 ticks").arg(drift).arg(ticks)));
+}
+
+void Benchmarks::tickDeadlines()
+{
+    // An hour at 127 BPM is 127 * 24 * 60 ticks, each 2500000000 / 127 ns long
+    const qint64 hourTicks = 127 * 24 * 60;
+    const qint64 hour = Q_INT64_C(3600000000000);
+    QCOMPARE(Scheduler::tickTime(hourTicks, 127), hour);
+
+    // No tick is more than a nanosecond off its exact time
+    Scheduler::Deadlines deadlines;
+    deadlines.reset(0);
+    for (qint64 tick = 1; tick <= hourTicks; tick++) {
+        qint64 deadline = deadlines.next(127);
+        QCOMPARE(deadline, Scheduler::tickTime(tick, 127));
+        double exact = tick * 2500000000.0 / 127;
+        QVERIFY2(exact - deadline >= 0 && exact - deadline < 1, qPrintable(QString("Tick %1 at %2 ns").arg(tick).arg(deadline)));
+    }
+
+    // Half an hour at 127 BPM followed by half an hour at 120 BPM ends exactly an hour later
+    deadlines.reset(0);
+    qint64 deadline = 0;
+    for (qint64 tick = 0; tick < hourTicks / 2; tick++) {
+        deadline = deadlines.next(127);
+    }
+    for (qint64 tick = 0; tick < 120 * 24 * 30; tick++) {
+        deadline = deadlines.next(120);
+    }
+    QCOMPARE(deadline, hour);
+
+    // Changing the tempo every few hundred ticks only rounds once per change, never per tick
+    deadlines.reset(0);
+    qint64 previous = 0;
+    double exact = 0;
+    int changes = 0;
+    for (qint64 tick = 0; tick < hourTicks; tick++) {
+        unsigned int tempo = 100 + (tick / 300) % 56;
+        if (tick % 300 == 0) {
+            exact += qMin(Q_INT64_C(300), hourTicks - tick) * 2500000000.0 / tempo;
+            changes++;
+        }
+        deadline = deadlines.next(tempo);
+        QVERIFY(deadline > previous);
+        previous = deadline;
+    }
+    QVERIFY2(exact - deadline > -1 && exact - deadline < changes, qPrintable(QString("%1 ns off after %2 tempo changes").arg(exact - deadline).arg(changes)));
+}
+
+void Benchmarks::clockFollowerJitter()
+{
+    // A 120 BPM clock arriving with about 1 ms of jitter that doubles its tempo halfway
+    const int clocks = 2000;
+    qint64 period = 20833333;
+    qint64 time = 0;
+    unsigned int seed = 1;
+
+    ClockFollower follower;
+    double inputSum = 0, inputSquares = 0, outputSum = 0, outputSquares = 0;
+    int measured = 0;
+    for (int clock = 1; clock <= clocks; clock++) {
+        if (clock == clocks / 2) {
+            period /= 2;
+        }
+        time += period;
+
+        // Sum of uniform random numbers for a roughly normal distribution
+        qint64 jitter = 0;
+        for (int i = 0; i < 12; i++) {
+            seed = seed * 1103515245 + 12345;
+            jitter += (seed >> 16) % 1000;
+        }
+        jitter = (jitter - 6000) * 1000;
+
+        follower.clock(time + jitter);
+        qint64 output = follower.clockTime(follower.clocks()) - time;
+
+        // Leave out locking to the clock at the beginning and after the tempo change
+        if (clock > 100 && (clock < clocks / 2 || clock > clocks / 2 + 50)) {
+            inputSum += jitter;
+            inputSquares += (double)jitter * jitter;
+            outputSum += output;
+            outputSquares += (double)output * output;
+            measured++;
+        }
+    }
+
+    double inputJitter = std::sqrt(inputSquares / measured - (inputSum / measured) * (inputSum / measured));
+    double outputJitter = std::sqrt(outputSquares / measured - (outputSum / measured) * (outputSum / measured));
+    QVERIFY2(outputJitter < inputJitter / 2, qPrintable(QString("Output jitter %1 ns, input jitter %2 ns").arg(outputJitter).arg(inputJitter)));
+}
+
+void Benchmarks::thruLatency()
+{
+    LoopbackMIDI midi;
+    LoopbackMIDIInterface *output = midi.loopbackOutput();
+    midi.thru()->setRoute(midi.output(0), 2, 12);
+
+    // Each note played on channel 1 should come out on channel 3 an octave higher before the next one is played
+    LatencyHistogram histogram;
+    for (int message = 0; message < 1000; message++) {
+        unsigned char note = 36 + (message / 2) % 48;
+        qint64 playTime = ClockFollower::currentTime();
+        midi.play(MIDIMessage(3, message % 2 == 0 ? 0x90 : 0x80, note, 100));
+
+        MIDIMessage sent;
+        qint64 time;
+        QVERIFY2(output->waitForWrite(sent, time), "Nothing was sent");
+        QCOMPARE((int)sent.data()[0], message % 2 == 0 ? 0x92 : 0x82);
+        QCOMPARE((int)sent.data()[1], note + 12);
+        histogram.record(time - playTime);
+    }
+
+    // The round trip times depend on the machine and its load, so they are reported for comparing builds rather than checked
+    qInfo("Thru round trip of %llu messages: %s", histogram.count(), qPrintable(histogram.summary()));
+}
+
+Block *Benchmarks::createBlock(int tracks, int lines, int commandPages, unsigned int seed)
+{
+    Block *block = new Block(tracks, lines, commandPages);
+
+    for (int line = 0; line < lines; line++) {
+        for (int track = 0; track < tracks; track++) {
+            seed = seed * 1103515245 + 12345;
+            unsigned int random = seed >> 16;
+
+            // A note on every other line, a velocity and occasionally a controller or pitch wheel change
+            if ((line + track) % 2 == 0) {
+                block->setNoteFull(line, track, 36 + random % 48, 1 + (random >> 8) % 8);
+                block->setCommandFull(line, track, 0, Player::CommandVelocity, 64 + random % 64);
+            }
+            if (commandPages > 1 && random % 4 == 0) {
+                block->setCommandFull(line, track, 1, Player::CommandMidiControllers + 7, random % 128);
+            }
+            if (commandPages > 2 && random % 8 == 0) {
+                block->setCommandFull(line, track, 2, Player::CommandPitchWheel, random % 128);
+            }
+        }
+    }
+
+    return block;
+}
+
+Song *Benchmarks::createSong(int blocks, int tracks, int lines, int commandPages)
+{
+    Song *song = new Song;
+    song->checkInstrument(7);
+
+    Block *first = song->block(0);
+    first->setTracks(tracks);
+    first->setLength(lines);
+    first->setCommandPages(commandPages);
+    for (int number = 1; number < blocks; number++) {
+        song->insertBlock(number, 0);
+    }
+
+    Playseq *playseq = song->playseq(0);
+    for (int number = 0; number < blocks; number++) {
+        Block *block = createBlock(tracks, lines, commandPages, number + 1);
+        song->block(number)->paste(block, 0, 0);
+        delete block;
+
+        if (number > 0) {
+            playseq->insert(number);
+        }
+        playseq->set(number, number);
+    }
+
+    return song;
+}
+
+QTEST_GUILESS_MAIN(Benchmarks)
+
+#include "benchmarks.moc"
@@ -0,0 +1,80 @@
+MOC_DIR = .moc
+OBJECTS_DIR = .obj
+
+# The playback engine and the song model are compiled in from the application sources
+VPATH += ../src
+INCLUDEPATH += ../src
+
+SOURCES += benchmarks.cpp \
+    block.cpp \
+    blocktimeline.cpp \
+    instrument.cpp \
+    message.cpp \
+    playseq.cpp \
+    song.cpp \
+    track.cpp \
+    player.cpp \
+    midi.cpp \
+    midiinterface.cpp \
+    midioutputqueue.cpp \
+    midiinputqueue.cpp \
+    miditracer.cpp \
+    mmd.cpp \
+    conversion.cpp \
+    smf.cpp \
+    buffermidi.cpp \
+    buffermidiinterface.cpp \
+    scheduler.cpp \
+    clockfollower.cpp \
+    latencyhistogram.cpp \
+    midithru.cpp \
+    loopbackmidi.cpp
+
+HEADERS += block.h \
+    blocktimeline.h \
+    instrument.h \
+    message.h \
+    playseq.h \
+    song.h \
+    track.h \
+    player.h \
+    midi.h \
+    midiinterface.h \
+    midimessage.h \
+    midioutputqueue.h \
+    midiinputqueue.h \
+    miditracer.h \
+    mmd.h \
+    conversion.h \
+    smf.h \
+    buffermidi.h \
+    buffermidiinterface.h \
+    scheduler.h \
+    clockfollower.h \
+    latencyhistogram.h \
+    midithru.h \
+    loopbackmidi.h
+
+TEMPLATE = app
+TARGET = benchmarks
+CONFIG += console
+CONFIG -= app_bundle
+QT += xml testlib
+QT -= gui
+DEFINES += QT_NO_DEBUG_OUTPUT
+
+unix:!macx:SOURCES += schedulermonotonic.cpp
+unix:!macx:HEADERS += schedulermonotonic.h
+
+# "make benchmark" runs the benchmarks and writes the results to benchmarks.xml for comparing builds
+benchmark.commands = ./$(TARGET) -o benchmarks.xml,xml -o -,txt
+benchmark.depends = $(TARGET)
+QMAKE_EXTRA_TARGETS += benchmark
+
+QMAKE_CXXFLAGS += \
+    -g \
+    -Werror \
+    -fsigned-char
+QMAKE_CXXFLAGS_WARN_ON += \
+    -Wno-strict-overflow \
+    -Wno-sign-compare
@@ -0,0 +1,119 @@
+/*
+ * loopbackmidi.cpp
+ *
+ * Copyright 2002-2019 Vesa Halttunen
+ *
+ * This file is part of Tutka.
+ *
+ * Tutka is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tutka is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tutka; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "clockfollower.h"
+#include "loopbackmidi.h"
+
+LoopbackMIDIInterface::LoopbackMIDIInterface() :
+    MIDIInterface(MIDIInterface::Output)
+{
+    enableQueue();
+    setEnabled(true);
+}
+
+bool LoopbackMIDIInterface::waitForWrite(MIDIMessage &message, qint64 &time, int timeout)
+{
+    if (!written.tryAcquire(1, timeout)) {
+        return false;
+    }
+
+    mutex.lock();
+    QPair<MIDIMessage, qint64> written = messages.takeFirst();
+    mutex.unlock();
+
+    message = written.first;
+    time = written.second;
+    return true;
+}
+
+void LoopbackMIDIInterface::write(const MIDIMessage &message)
+{
+    qint64 time = ClockFollower::currentTime();
+
+    mutex.lock();
+    messages.append(qMakePair(message, time));
+    mutex.unlock();
+
+    written.release();
+}
+
+LoopbackMIDI::LoopbackMIDI(QObject *parent) :
+    MIDI(parent),
+    inputThread(this)
+{
+    updateInterfaces();
+    inputThread.start();
+}
+
+LoopbackMIDI::~LoopbackMIDI()
+{
+    // An empty message stops the input thread
+    play(MIDIMessage());
+    inputThread.wait();
+}
+
+void LoopbackMIDI::play(const MIDIMessage &message)
+{
+    qint64 time = ClockFollower::currentTime();
+
+    mutex.lock();
+    messages.append(qMakePair(message, time));
+    mutex.unlock();
+
+    played.release();
+}
+
+LoopbackMIDIInterface *LoopbackMIDI::loopbackOutput() const
+{
+    return static_cast<LoopbackMIDIInterface *>(outputs_[0].data());
+}
+
+void LoopbackMIDI::updateInterfaces()
+{
+    outputs_.clear();
+    outputs_.append(QSharedPointer<MIDIInterface>(new LoopbackMIDIInterface));
+    inputs_.clear();
+}
+
+LoopbackMIDI::InputThread::InputThread(LoopbackMIDI *midi) :
+        QThread(midi),
+        midi(midi)
+{
+}
+
+void LoopbackMIDI::InputThread::run()
+{
+    while (true) {
+        midi->played.acquire();
+
+        midi->mutex.lock();
+        QPair<MIDIMessage, qint64> played = midi->messages.takeFirst();
+        midi->mutex.unlock();
+
+        if (played.first.isEmpty()) {
+            break;
+        }
+
+        midi->receiveInput(played.first.data(), played.first.length(), played.second);
+        midi->commitInput();
+    }
+}
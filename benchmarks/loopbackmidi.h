@@ -0,0 +1,90 @@
+/*
+ * loopbackmidi.h
+ *
+ * Copyright 2002-2019 Vesa Halttunen
+ *
+ * This file is part of Tutka.
+ *
+ * Tutka is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tutka is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tutka; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef LOOPBACKMIDI_H
+#define LOOPBACKMIDI_H
+
+#include <QList>
+#include <QMutex>
+#include <QPair>
+#include <QSemaphore>
+#include <QThread>
+#include "midi.h"
+#include "midiinterface.h"
+
+// An output recording when each message is sent
+class LoopbackMIDIInterface : public MIDIInterface
+{
+public:
+    LoopbackMIDIInterface();
+
+    // Waits for a message to be sent; returns false if nothing was sent within the timeout
+    bool waitForWrite(MIDIMessage &message, qint64 &time, int timeout = 1000);
+
+protected:
+    virtual void write(const MIDIMessage &message);
+
+private:
+    QMutex mutex;
+    QSemaphore written;
+    // Messages sent and their CLOCK_MONOTONIC times in nanoseconds
+    QList<QPair<MIDIMessage, qint64> > messages;
+};
+
+// A backend whose input is played by the benchmarks and read by an input thread
+// like the one of a real backend, so that what happens between receiving a message
+// and sending it out again can be measured without hardware
+class LoopbackMIDI : public MIDI
+{
+public:
+    LoopbackMIDI(QObject *parent = NULL);
+    virtual ~LoopbackMIDI();
+
+    // Makes the message arrive at the input
+    void play(const MIDIMessage &message);
+
+    // Returns the output
+    LoopbackMIDIInterface *loopbackOutput() const;
+
+protected:
+    virtual void updateInterfaces();
+
+private:
+    // Reads the played messages
+    class InputThread : public QThread
+    {
+    public:
+        InputThread(LoopbackMIDI *midi);
+        virtual void run();
+
+    private:
+        LoopbackMIDI *midi;
+    };
+
+    QMutex mutex;
+    QSemaphore played;
+    // Messages played and not read yet with the times they were played
+    QList<QPair<MIDIMessage, qint64> > messages;
+    InputThread inputThread;
+};
+
+#endif // LOOPBACKMIDI_H
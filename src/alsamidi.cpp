@@ -23,15 +23,20 @@
 #include <QTimer>
 #include "alsamidiinterface.h"
 #include "alsamidi.h"
+#include "clockfollower.h"
 
 AlsaMIDI::AlsaMIDI(QObject *parent) :
     MIDI(parent),
     seq(NULL),
     client(0),
     port(0),
+    queue(-1),
+    scheduleStart(0),
     encoder(NULL),
     decoder(NULL),
-    inputThread(this)
+    inputThread(this),
+    outputThread(this),
+    inputAcquired(false)
 {
     snd_seq_addr_t sender, dest;
     snd_seq_port_subscribe_t *subs;
@@ -66,17 +71,33 @@ AlsaMIDI::AlsaMIDI(QObject *parent) :
             snd_midi_event_no_status(encoder, 1);
             snd_midi_event_no_status(decoder, 1);
 
+            // Create a queue for delivering messages at given times; it runs as long as the client exists
+            queue = snd_seq_alloc_named_queue(seq, "Tutka");
+            if (queue < 0) {
+                qWarning("Couldn't create queue: %s", snd_strerror(queue));
+            } else {
+                snd_seq_start_queue(seq, queue, NULL);
+                snd_seq_drain_output(seq);
+            }
+
             updateInterfaces();
         }
     }
 
     inputThread.start();
+    outputThread.start(QThread::TimeCriticalPriority);
 }
 
 AlsaMIDI::~AlsaMIDI()
 {
+    // Release the notes held by the thru while the output thread can still send them
+    thru()->setRoute(QSharedPointer<MIDIInterface>(), 0, 0);
+
 	inputThread.terminate();
 	inputThread.wait();
+    outputThread.requestInterruption();
+    outputsWakeup.release();
+    outputThread.wait();
 
     if (seq != NULL) {
         snd_seq_addr_t sender, dest;
@@ -96,6 +117,13 @@ AlsaMIDI::~AlsaMIDI()
         inputs_.clear();
         outputs_.clear();
 
+        // Stop and free the queue
+        if (queue >= 0) {
+            snd_seq_stop_queue(seq, queue, NULL);
+            snd_seq_drain_output(seq);
+            snd_seq_free_queue(seq, queue);
+        }
+
         // Free MIDI event encoder and decoder
         if (encoder != NULL) {
             snd_midi_event_free(encoder);
@@ -117,7 +145,16 @@ AlsaMIDI::~AlsaMIDI()
 
 void AlsaMIDI::updateInterfaces()
 {
-    MIDI::updateInterfaces();
+    // Interfaces are only added or detached so that the numbers of the existing ones never change
+    QSet<MIDIInterface *> present;
+    bool outputsUpdated = false;
+    bool inputsUpdated = false;
+
+    outputsMutex.lock();
+
+    if (outputs_.isEmpty()) {
+        MIDI::updateInterfaces();
+    }
 
     snd_seq_client_info_t *cinfo;
     snd_seq_client_info_alloca(&cinfo);
@@ -137,29 +174,244 @@ void AlsaMIDI::updateInterfaces()
             bool isOutput = (snd_seq_port_info_get_capability(pinfo) & (SND_SEQ_PORT_CAP_WRITE | SND_SEQ_PORT_CAP_SUBS_WRITE)) != 0;
             bool isInput = (snd_seq_port_info_get_capability(pinfo) & (SND_SEQ_PORT_CAP_READ | SND_SEQ_PORT_CAP_SUBS_READ)) != 0;
             if ((isOutput || isInput) && !(client == this->client && port == this->port)) {
-                // Create an interface structure for the port
                 if (isOutput) {
-                    MIDIInterface *interface = new AlsaMIDIInterface(this, pinfo, MIDIInterface::Output);
-                    connect(interface, SIGNAL(enabledChanged(bool)), this, SIGNAL(outputEnabledChanged(bool)));
-                    outputs_.append(QSharedPointer<MIDIInterface>(interface));
+                    outputsUpdated |= updateInterface(outputs_, pinfo, MIDIInterface::Output, present);
                 }
 
                 if (isInput) {
-                    MIDIInterface *interface = new AlsaMIDIInterface(this, pinfo, MIDIInterface::Input);
-                    connect(interface, SIGNAL(enabledChanged(bool)), this, SIGNAL(inputEnabledChanged(bool)));
-                    connect(interface, SIGNAL(inputReceived(QByteArray)), this, SIGNAL(inputReceived(QByteArray)));
-                    connect(interface, SIGNAL(startReceived()), this, SIGNAL(startReceived()));
-                    connect(interface, SIGNAL(stopReceived()), this, SIGNAL(stopReceived()));
-                    connect(interface, SIGNAL(continueReceived()), this, SIGNAL(continueReceived()));
-                    connect(interface, SIGNAL(clockReceived()), this, SIGNAL(clockReceived()));
-                    inputs_.append(QSharedPointer<MIDIInterface>(interface));
+                    inputsUpdated |= updateInterface(inputs_, pinfo, MIDIInterface::Input, present);
                 }
             }
         }
     }
 
-    emit outputsChanged();
-    emit inputsChanged();
+    outputsUpdated |= disconnectMissing(outputs_, present);
+    inputsUpdated |= disconnectMissing(inputs_, present);
+
+    outputsMutex.unlock();
+
+    if (outputsUpdated) {
+        emit outputsChanged();
+    }
+    if (inputsUpdated) {
+        emit inputsChanged();
+    }
+}
+
+bool AlsaMIDI::updateInterface(QList<QSharedPointer<MIDIInterface> > &interfaces, snd_seq_port_info_t *pinfo, MIDIInterface::DirectionFlags flags, QSet<MIDIInterface *> &present)
+{
+    int client = snd_seq_port_info_get_client(pinfo);
+    int port = snd_seq_port_info_get_port(pinfo);
+    QString name = snd_seq_port_info_get_name(pinfo);
+
+    AlsaMIDIInterface *detached = NULL;
+    for (int index = 0; index < interfaces.count(); index++) {
+        AlsaMIDIInterface *interface = qobject_cast<AlsaMIDIInterface *>(interfaces[index].data());
+        if (interface == NULL) {
+            continue;
+        }
+
+        if (interface->isPort(client, port)) {
+            present.insert(interface);
+            return interface->updateName(pinfo);
+        }
+
+        if (detached == NULL && !interface->isConnected() && interface->name() == name) {
+            detached = interface;
+        }
+    }
+
+    // A port that returns gets its old interface back along with its number and whether it is enabled
+    if (detached != NULL) {
+        detached->connectPort(pinfo);
+        present.insert(detached);
+        return true;
+    }
+
+    // Create an interface structure for the port
+    AlsaMIDIInterface *interface = new AlsaMIDIInterface(this, pinfo, flags);
+    if ((flags & MIDIInterface::Output) != 0) {
+        connect(interface, SIGNAL(enabledChanged(bool)), this, SIGNAL(outputEnabledChanged(bool)));
+    } else {
+        connect(interface, SIGNAL(enabledChanged(bool)), this, SIGNAL(inputEnabledChanged(bool)));
+        connect(interface, SIGNAL(inputReceived(QByteArray)), this, SIGNAL(inputReceived(QByteArray)));
+        connect(interface, SIGNAL(startReceived()), this, SIGNAL(startReceived()));
+        connect(interface, SIGNAL(stopReceived()), this, SIGNAL(stopReceived()));
+        connect(interface, SIGNAL(continueReceived()), this, SIGNAL(continueReceived()));
+        connect(interface, SIGNAL(clockReceived(qint64)), this, SIGNAL(clockReceived(qint64)));
+    }
+    interfaces.append(QSharedPointer<MIDIInterface>(interface));
+    present.insert(interface);
+
+    return true;
+}
+
+bool AlsaMIDI::disconnectMissing(QList<QSharedPointer<MIDIInterface> > &interfaces, const QSet<MIDIInterface *> &present)
+{
+    bool changed = false;
+
+    for (int index = 0; index < interfaces.count(); index++) {
+        AlsaMIDIInterface *interface = qobject_cast<AlsaMIDIInterface *>(interfaces[index].data());
+        if (interface != NULL && interface->isConnected() && !present.contains(interface)) {
+            interface->disconnectPort();
+            changed = true;
+        }
+    }
+
+    return changed;
+}
+
+bool AlsaMIDI::canSchedule() const
+{
+    return queue >= 0;
+}
+
+void AlsaMIDI::startSchedule()
+{
+    if (queue < 0) {
+        return;
+    }
+
+    // The output thread uses the sequencer handle while holding the outputs mutex
+    snd_seq_queue_status_t *status;
+    snd_seq_queue_status_alloca(&status);
+    outputsMutex.lock();
+    if (snd_seq_get_queue_status(seq, queue, status) >= 0) {
+        const snd_seq_real_time_t *time = snd_seq_queue_status_get_real_time(status);
+        scheduleStart = (qint64)time->tv_sec * 1000000000 + time->tv_nsec;
+    }
+    outputsMutex.unlock();
+}
+
+void AlsaMIDI::discardSchedule()
+{
+    if (queue < 0) {
+        return;
+    }
+
+    // Pass the messages still waiting in the output queues to the sequencer so they can be removed as well;
+    // the output thread must not write to the sequencer meanwhile
+    outputsMutex.lock();
+    for (int output = 0; output < outputs_.count(); output++) {
+        outputs_[output]->flushQueue();
+    }
+
+    // Note offs are left in the queue so notes that have already started won't hang
+    snd_seq_remove_events_t *remove;
+    snd_seq_remove_events_alloca(&remove);
+    snd_seq_remove_events_set_queue(remove, queue);
+    snd_seq_remove_events_set_condition(remove, SND_SEQ_REMOVE_OUTPUT | SND_SEQ_REMOVE_IGNORE_OFF);
+    snd_seq_remove_events(seq, remove);
+    outputsMutex.unlock();
+}
+
+QList<int> AlsaMIDI::inputDescriptors() const
+{
+    QList<int> descriptors;
+
+    if (seq != NULL) {
+        int pollDescriptorCount = snd_seq_poll_descriptors_count(seq, POLLIN);
+        struct pollfd pollDescriptors[pollDescriptorCount];
+        snd_seq_poll_descriptors(seq, pollDescriptors, pollDescriptorCount, POLLIN);
+        for (int descriptor = 0; descriptor < pollDescriptorCount; descriptor++) {
+            descriptors.append(pollDescriptors[descriptor].fd);
+        }
+    }
+
+    return descriptors;
+}
+
+void AlsaMIDI::acquireInput()
+{
+    // Waits for the input thread to finish reading if it is doing so
+    inputMutex.lock();
+    inputAcquired = true;
+    inputMutex.unlock();
+}
+
+void AlsaMIDI::releaseInput()
+{
+    inputMutex.lock();
+    inputAcquired = false;
+    inputReleased.wakeAll();
+    inputMutex.unlock();
+}
+
+unsigned int AlsaMIDI::readInput()
+{
+    unsigned int clocks = 0;
+    bool clockEnabled = this->clockEnabled();
+    qint64 time = ClockFollower::currentTime();
+    bool queued = false;
+    bool portsChanged = false;
+
+    snd_seq_event_t *ev;
+    while (seq != NULL && snd_seq_event_input(seq, &ev) >= 0) {
+        switch (ev->type) {
+        case SND_SEQ_EVENT_START:
+            emit startReceived();
+            break;
+        case SND_SEQ_EVENT_CONTINUE:
+            emit continueReceived();
+            break;
+        case SND_SEQ_EVENT_STOP:
+            emit stopReceived();
+            break;
+        case SND_SEQ_EVENT_CLOCK:
+            if (clockEnabled) {
+                clocks++;
+            }
+            break;
+        case SND_SEQ_EVENT_SENSING:
+            // Active sensing is of no use
+            break;
+        case SND_SEQ_EVENT_SONGPOS:
+            emit songPositionReceived(ev->data.control.value);
+            break;
+        case SND_SEQ_EVENT_PORT_START:
+        case SND_SEQ_EVENT_PORT_EXIT:
+        case SND_SEQ_EVENT_PORT_CHANGE:
+            // Ports have been added, removed or changed so update interfaces once everything has been read
+            portsChanged = true;
+            break;
+        default: {
+            // Get the event to the incoming buffer and decode it
+            int length = snd_seq_event_length(ev);
+            unsigned char temp[length];
+            int decoded = snd_midi_event_decode(decoder, temp, length, ev);
+            if (decoded > 0) {
+                receiveInput(temp, decoded, time);
+                queued = true;
+            }
+            break;
+        }
+        }
+    }
+
+    // Deliver everything read at once
+    if (queued) {
+        commitInput();
+    }
+
+    // The interfaces are only changed in the main thread, which uses them without locking
+    if (portsChanged) {
+        QMetaObject::invokeMethod(this, "updateInterfaces", Qt::QueuedConnection);
+    }
+
+    return clocks;
+}
+
+void AlsaMIDI::flushThru(MIDIInterface *output)
+{
+    // The output thread may be flushing the same output and the output may have been removed since it was written to
+    outputsMutex.lock();
+    for (int index = 0; index < outputs_.count(); index++) {
+        if (outputs_[index].data() == output) {
+            output->flushQueue();
+            break;
+        }
+    }
+    outputsMutex.unlock();
 }
 
 AlsaMIDI::InputThread::InputThread(AlsaMIDI *midi) :
@@ -176,39 +428,46 @@ void AlsaMIDI::InputThread::run()
         snd_seq_poll_descriptors(midi->seq, pollDescriptors, pollDescriptorCount, POLLIN);
 
         if (poll(pollDescriptors, pollDescriptorCount, -1) > 0) {
-            snd_seq_event_t *ev;
-            while (snd_seq_event_input(midi->seq, &ev) >= 0) {
-                switch (ev->type) {
-                case SND_SEQ_EVENT_START:
-                    emit midi->startReceived();
-                    break;
-                case SND_SEQ_EVENT_CONTINUE:
-                    emit midi->continueReceived();
-                    break;
-                case SND_SEQ_EVENT_STOP:
-                    emit midi->stopReceived();
-                    break;
-                case SND_SEQ_EVENT_CLOCK:
-                    emit midi->clockReceived();
-                    break;
-                case SND_SEQ_EVENT_PORT_START:
-                case SND_SEQ_EVENT_PORT_EXIT:
-                case SND_SEQ_EVENT_PORT_CHANGE:
-                    // Ports have been added, removed or changed so update interfaces
-                    midi->updateInterfaces();
-                    break;
-                default: {
-                    // Get the event to the incoming buffer and decode it
-                    int length = snd_seq_event_length(ev);
-                    unsigned char temp[length];
-                    int decoded = snd_midi_event_decode(midi->decoder, temp, length, ev);
-                    if (decoded >= 0) {
-                        emit midi->inputReceived(QByteArray((const char*)(temp), decoded));
-                    }
-                    break;
-                }
-                }
+            // Leave the input alone while someone else reads it
+            midi->inputMutex.lock();
+            while (midi->inputAcquired) {
+                midi->inputReleased.wait(&midi->inputMutex);
+            }
+            qint64 time = ClockFollower::currentTime();
+            unsigned int clocks = midi->readInput();
+            midi->inputMutex.unlock();
+
+            for (; clocks > 0; clocks--) {
+                emit midi->clockReceived(time);
             }
         }
     }
 }
+
+AlsaMIDI::OutputThread::OutputThread(AlsaMIDI *midi) :
+        QThread(midi),
+        midi(midi)
+{
+}
+
+void AlsaMIDI::OutputThread::run()
+{
+    while (!isInterruptionRequested()) {
+        // Sleep until something is queued; one pass sends everything queued so far
+        midi->outputsWakeup.acquire();
+        midi->outputsWakeup.tryAcquire(midi->outputsWakeup.available());
+
+        midi->outputsMutex.lock();
+        for (int output = 0; output < midi->outputs_.count(); output++) {
+            midi->outputs_[output]->flushQueue();
+        }
+        midi->outputsMutex.unlock();
+    }
+
+    // Send whatever was queued before stopping
+    midi->outputsMutex.lock();
+    for (int output = 0; output < midi->outputs_.count(); output++) {
+        midi->outputs_[output]->flushQueue();
+    }
+    midi->outputsMutex.unlock();
+}
@@ -24,8 +24,13 @@
 #define ALSAMIDI_H
 
 #include <QThread>
+#include <QMutex>
+#include <QSemaphore>
+#include <QSet>
+#include <QWaitCondition>
 #include <alsa/asoundlib.h>
 #include "midi.h"
+#include "midiinterface.h"
 
 class AlsaMIDI : public MIDI
 {
@@ -35,10 +40,27 @@ public:
     explicit AlsaMIDI(QObject *parent = NULL);
     virtual ~AlsaMIDI();
 
+    virtual bool canSchedule() const;
+    virtual void startSchedule();
+    virtual void discardSchedule();
+    virtual QList<int> inputDescriptors() const;
+    virtual void acquireInput();
+    virtual void releaseInput();
+    virtual unsigned int readInput();
+
+protected:
+    virtual void flushThru(MIDIInterface *output);
+
 protected slots:
     virtual void updateInterfaces();
 
 private:
+    // Finds or creates the interface of a port; returns whether the interfaces changed
+    bool updateInterface(QList<QSharedPointer<MIDIInterface> > &interfaces, snd_seq_port_info_t *pinfo, MIDIInterface::DirectionFlags flags, QSet<MIDIInterface *> &present);
+
+    // Detaches the interfaces whose ports were not found; returns whether the interfaces changed
+    bool disconnectMissing(QList<QSharedPointer<MIDIInterface> > &interfaces, const QSet<MIDIInterface *> &present);
+
     class InputThread : public QThread
     {
     public:
@@ -49,6 +71,17 @@ private:
         AlsaMIDI *midi;
     };
 
+    // Sends the messages queued to the output interfaces
+    class OutputThread : public QThread
+    {
+    public:
+        OutputThread(AlsaMIDI *midi);
+        virtual void run();
+
+    private:
+        AlsaMIDI *midi;
+    };
+
     // ALSA MIDI sequencer interface
     snd_seq_t *seq;
 
@@ -58,6 +91,12 @@ private:
     // Sequencer port ID
     int port;
 
+    // Sequencer queue delivering scheduled messages; negative if not available
+    int queue;
+
+    // Real time of the queue when the current schedule started in nanoseconds
+    qint64 scheduleStart;
+
     // MIDI event encoder
     snd_midi_event_t *encoder;
 
@@ -67,6 +106,24 @@ private:
     // Input thread
     InputThread inputThread;
 
+    // Output thread
+    OutputThread outputThread;
+
+    // Mutex for changing the output interfaces while the output thread is using them
+    QMutex outputsMutex;
+
+    // Wakes up the output thread when messages have been queued
+    QSemaphore outputsWakeup;
+
+    // Held while the input thread reads the input
+    QMutex inputMutex;
+
+    // Whether the input is read by someone else than the input thread
+    bool inputAcquired;
+
+    // Wakes up the input thread when the input is released
+    QWaitCondition inputReleased;
+
     friend class AlsaMIDIInterface;
 };
 
@@ -26,28 +26,18 @@
 AlsaMIDIInterface::AlsaMIDIInterface(AlsaMIDI *midi, snd_seq_port_info_t *pinfo, DirectionFlags flags, QObject *parent) :
     MIDIInterface(flags, parent),
     midi(midi),
-    client(snd_seq_port_info_get_client(pinfo)),
-    port(snd_seq_port_info_get_port(pinfo)),
-    subs(NULL)
+    client(-1),
+    port(-1),
+    subs(NULL),
+    connected(true)
 {
-    name_ = snd_seq_port_info_get_name(pinfo);
-
-    snd_seq_addr_t sender, dest;
+    snd_seq_port_subscribe_malloc(&subs);
+    setPort(pinfo);
 
+    // Messages are sent by the output thread
     if ((flags & Output) != 0) {
-        sender.client = midi->client;
-        sender.port = midi->port;
-        dest.client = client;
-        dest.port = port;
-    } else {
-        sender.client = client;
-        sender.port = port;
-        dest.client = midi->client;
-        dest.port = midi->port;
+        enableQueue(&midi->outputsWakeup);
     }
-    snd_seq_port_subscribe_malloc(&subs);
-    snd_seq_port_subscribe_set_sender(subs, &sender);
-    snd_seq_port_subscribe_set_dest(subs, &dest);
 }
 
 AlsaMIDIInterface::~AlsaMIDIInterface()
@@ -55,20 +45,48 @@ AlsaMIDIInterface::~AlsaMIDIInterface()
     snd_seq_port_subscribe_free(subs);
 }
 
+void AlsaMIDIInterface::write(const MIDIMessage &message)
+{
+    encode(message.data(), message.length());
+}
+
 void AlsaMIDIInterface::write(const QByteArray &data)
 {
+    encode((const unsigned char *)data.constData(), data.length());
+}
+
+void AlsaMIDIInterface::encode(const unsigned char *data, int length)
+{
+    // Messages to a removed port are dropped until it returns
+    if (!connected) {
+        return;
+    }
+
     // Create event
     snd_seq_event_t ev;
     snd_seq_ev_clear(&ev);
     snd_seq_ev_set_source(&ev, midi->port);
     snd_seq_ev_set_dest(&ev, client, port);
-    snd_seq_ev_set_direct(&ev);
+    if (writeTime >= 0 && midi->queue >= 0) {
+        // Let the sequencer deliver the message at the exact time
+        qint64 deliveryTime = midi->scheduleStart + writeTime;
+        snd_seq_real_time_t time;
+        time.tv_sec = deliveryTime / 1000000000;
+        time.tv_nsec = deliveryTime % 1000000000;
+        snd_seq_ev_schedule_real(&ev, midi->queue, 0, &time);
+    } else {
+        snd_seq_ev_set_direct(&ev);
+    }
 
     // The encoder may send the data in multiple packets
-    for (int sent = 0; sent < data.length();) {
-        sent += snd_midi_event_encode(midi->encoder, (const unsigned char *)(data.constData() + sent), data.length() - sent, &ev);
+    for (int sent = 0; sent < length;) {
+        sent += snd_midi_event_encode(midi->encoder, data + sent, length - sent, &ev);
         snd_seq_event_output(midi->seq, &ev);
     }
+}
+
+void AlsaMIDIInterface::drain()
+{
     snd_seq_drain_output(midi->seq);
 }
 
@@ -78,7 +96,7 @@ void AlsaMIDIInterface::setEnabled(bool enabled)
 
     MIDIInterface::setEnabled(enabled);
 
-    if (enabled != wasEnabled) {
+    if (enabled != wasEnabled && connected) {
         if (enabled) {
             snd_seq_subscribe_port(midi->seq, subs);
         } else {
@@ -86,3 +104,63 @@ void AlsaMIDIInterface::setEnabled(bool enabled)
         }
     }
 }
+
+bool AlsaMIDIInterface::isPort(int client, int port) const
+{
+    return connected && this->client == client && this->port == port;
+}
+
+bool AlsaMIDIInterface::isConnected() const
+{
+    return connected;
+}
+
+void AlsaMIDIInterface::connectPort(snd_seq_port_info_t *pinfo)
+{
+    setPort(pinfo);
+    connected = true;
+
+    if (isEnabled()) {
+        snd_seq_subscribe_port(midi->seq, subs);
+    }
+}
+
+void AlsaMIDIInterface::disconnectPort()
+{
+    // The sequencer removes the subscriptions of a removed port by itself
+    connected = false;
+}
+
+bool AlsaMIDIInterface::updateName(snd_seq_port_info_t *pinfo)
+{
+    QString name = snd_seq_port_info_get_name(pinfo);
+    if (name == name_) {
+        return false;
+    }
+
+    name_ = name;
+    return true;
+}
+
+void AlsaMIDIInterface::setPort(snd_seq_port_info_t *pinfo)
+{
+    client = snd_seq_port_info_get_client(pinfo);
+    port = snd_seq_port_info_get_port(pinfo);
+    name_ = snd_seq_port_info_get_name(pinfo);
+
+    snd_seq_addr_t sender, dest;
+
+    if ((flags_ & Output) != 0) {
+        sender.client = midi->client;
+        sender.port = midi->port;
+        dest.client = client;
+        dest.port = port;
+    } else {
+        sender.client = client;
+        sender.port = port;
+        dest.client = midi->client;
+        dest.port = midi->port;
+    }
+    snd_seq_port_subscribe_set_sender(subs, &sender);
+    snd_seq_port_subscribe_set_dest(subs, &dest);
+}
@@ -36,20 +36,44 @@ public:
     explicit AlsaMIDIInterface(AlsaMIDI *midi, snd_seq_port_info_t *pinfo, DirectionFlags flags, QObject *parent = NULL);
     virtual ~AlsaMIDIInterface();
 
+    virtual void write(const MIDIMessage &message);
     virtual void write(const QByteArray &data);
+    virtual void drain();
     virtual void setEnabled(bool enabled);
 
+    // Returns whether the interface is attached to the given sequencer port
+    bool isPort(int client, int port) const;
+
+    // Returns whether the port of the interface exists; a missing port keeps its place until it returns
+    bool isConnected() const;
+
+    // Attaches the interface to a port that has appeared; the subscription is restored if the interface is enabled
+    void connectPort(snd_seq_port_info_t *pinfo);
+
+    // Detaches the interface from a port that has been removed
+    void disconnectPort();
+
+    // Updates the name of the port; returns whether it changed
+    bool updateName(snd_seq_port_info_t *pinfo);
+
 signals:
     void startReceived();
     void stopReceived();
     void continueReceived();
-    void clockReceived();
+    void clockReceived(qint64 time);
 
 private:
+    // Encodes a message to the sequencer's output buffer
+    void encode(const unsigned char *data, int length);
+
+    // Points the subscription to the given port
+    void setPort(snd_seq_port_info_t *pinfo);
+
     AlsaMIDI *midi;
     int client;
     int port;
     snd_seq_port_subscribe_t *subs;
+    bool connected;
 };
 
 #endif // ALSAMIDIINTERFACE_H
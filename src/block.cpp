@@ -22,6 +22,7 @@
 
 #include <cstddef>
 #include <cstdlib>
+#include <cstring>
 #include <QDomElement>
 #include "block.h"
 
@@ -29,18 +30,20 @@ Block::Block(unsigned int tracks, unsigned int length, unsigned int commandPages
     QObject(parent),
     tracks_(tracks),
     length_(length),
-    notes_(NULL),
     commandPages_(commandPages),
-    commands_(NULL)
+    cellSize_(2 + 2 * commandPages),
+    chunks_((length + CHUNK_LINES - 1) / CHUNK_LINES)
 {
-    notes_ = (unsigned char *)calloc(2 * tracks * length, sizeof(unsigned char));
-    commands_ = (unsigned char *)calloc(commandPages * 2 * tracks * length, sizeof(unsigned char));
+    compileTimeline(0, length - 1);
+
+    connect(this, SIGNAL(areaChanged(int, int, int, int)), this, SLOT(compileArea(int, int, int, int)));
 }
 
 Block::~Block()
 {
-    free(notes_);
-    free(commands_);
+    foreach (unsigned char *chunk, chunks_) {
+        free(chunk);
+    }
 }
 
 QString Block::name() const
@@ -62,35 +65,31 @@ unsigned int Block::tracks() const
 
 void Block::setTracks(unsigned int tracks)
 {
-    // Allocate new arrays
-    unsigned char *notes = (unsigned char *)calloc(2 * tracks * length_, sizeof(unsigned char));
-    unsigned char *commands = (unsigned char *)calloc(commandPages_ * 2 * tracks * length_, sizeof(unsigned char));
     unsigned int oldTracks = tracks_;
 
     // How many tracks from the old block to use
     unsigned int existingTracks = tracks < oldTracks ? tracks : oldTracks;
 
-    // Copy the notes and the commands of the block to a new data array
-    for (unsigned int line = 0; line < length_; line++) {
-        for (unsigned int track = 0; track < existingTracks; track++) {
-            notes[(line * tracks + track) * 2] = notes_[(line * oldTracks + track) * 2];
-            notes[(line * tracks + track) * 2 + 1] = notes_[(line * oldTracks + track) * 2 + 1];
-            for (unsigned int commandPage = 0; commandPage < commandPages_; commandPage++) {
-                commands[commandPage * 2 * tracks * length_ + (line * tracks + track) * 2] = commands_[commandPage * 2 * oldTracks * length_ + (line * oldTracks + track) * 2];
-                commands[commandPage * 2 * tracks * length_ + (line * tracks + track) * 2 + 1] = commands_[commandPage * 2 * oldTracks * length_ + (line * oldTracks + track) * 2 + 1];
+    // Copy the cells of the tracks on each line of the allocated chunks to new chunks
+    for (int index = 0; index < chunks_.count(); index++) {
+        unsigned char *oldChunk = chunks_[index];
+        if (oldChunk != NULL) {
+            unsigned char *chunk = (unsigned char *)calloc(CHUNK_LINES * tracks * cellSize_, sizeof(unsigned char));
+            for (unsigned int line = 0; line < CHUNK_LINES; line++) {
+                memcpy(chunk + line * tracks * cellSize_, oldChunk + line * oldTracks * cellSize_, existingTracks * cellSize_);
             }
+            free(oldChunk);
+            chunks_[index] = chunk;
         }
     }
 
-    // Free old arrays
-    free(notes_);
-    free(commands_);
-
-    // Use new arrays
-    notes_ = notes;
-    commands_ = commands;
     tracks_ = tracks;
 
+    // The removed tracks may have been all there was in some chunks
+    if (tracks < oldTracks) {
+        releaseEmptyChunks(0, length_ - 1);
+    }
+
     emit tracksChanged(tracks_);
     emit areaChanged(tracks > oldTracks ? oldTracks : tracks, 0, (tracks > oldTracks ? tracks : oldTracks) - 1, length_ - 1);
 }
@@ -102,35 +101,30 @@ unsigned int Block::length() const
 
 void Block::setLength(unsigned int length)
 {
-    // Allocate new arrays
-    unsigned char *notes = (unsigned char *)calloc(2 * tracks_ * length, sizeof(unsigned char));
-    unsigned char *commands = (unsigned char *)calloc(commandPages_ * 2 * tracks_ * length, sizeof(unsigned char));
     unsigned int oldLength = length_;
+    unsigned int chunks = (length + CHUNK_LINES - 1) / CHUNK_LINES;
 
-    // How many lines from the old block to use
-    unsigned int existingLength = length < oldLength ? length : oldLength;
-
-    // Copy the notes and the commands of the block to a new data array
-    for (unsigned int line = 0; line < existingLength; line++) {
-        for (unsigned int track = 0; track < tracks_; track++) {
-            notes[(line * tracks_ + track) * 2] = notes_[(line * tracks_ + track) * 2];
-            notes[(line * tracks_ + track) * 2 + 1] = notes_[(line * tracks_ + track) * 2 + 1];
-            for (unsigned int commandPage = 0; commandPage < commandPages_; commandPage++) {
-                commands[commandPage * 2 * tracks_ * length + (line * tracks_ + track) * 2] = commands_[commandPage * 2 * tracks_ * oldLength + (line * tracks_ + track) * 2];
-                commands[commandPage * 2 * tracks_ * length + (line * tracks_ + track) * 2 + 1] = commands_[commandPage * 2 * tracks_ * oldLength + (line * tracks_ + track) * 2 + 1];
-            }
+    if (length < oldLength) {
+        // Clear the removed lines of the last chunk kept so that they are empty if the block grows again
+        unsigned char *chunk = length % CHUNK_LINES != 0 ? chunks_[length / CHUNK_LINES] : NULL;
+        if (chunk != NULL) {
+            memset(chunk + (length % CHUNK_LINES) * tracks_ * cellSize_, 0, (CHUNK_LINES - length % CHUNK_LINES) * tracks_ * cellSize_);
         }
-    }
 
-    // Free old arrays
-    free(notes_);
-    free(commands_);
+        // Free the chunks of the removed lines
+        for (int index = chunks; index < chunks_.count(); index++) {
+            free(chunks_[index]);
+        }
+    }
 
-    // Use new arrays
-    notes_ = notes;
-    commands_ = commands;
+    // New lines are empty until something is written on them
+    chunks_.resize(chunks);
     length_ = length;
 
+    if (length < oldLength && length > 0) {
+        releaseEmptyChunks(length - 1, length - 1);
+    }
+
     emit lengthChanged(length_);
     emit areaChanged(0, length > oldLength ? oldLength : length, tracks_ - 1, (length > oldLength ? length : oldLength) - 1);
 }
@@ -142,39 +136,49 @@ unsigned int Block::commandPages() const
 
 void Block::setCommandPages(unsigned int commandPages)
 {
-    // Allocate new command page array
-    unsigned char *commands = (unsigned char *)calloc(commandPages * 2 * tracks_ * length_, sizeof(unsigned char));
-
-    // How many command pages from the old block to use
-    unsigned int existingCommandPages = commandPages < commandPages_ ? commandPages : commandPages_;
+    unsigned int oldCommandPages = commandPages_;
+    unsigned int cellSize = 2 + 2 * commandPages;
 
-    // Copy the command pages to a new data array
-    memcpy(commands, commands_, existingCommandPages * 2 * tracks_ * length_);
+    // How many bytes of each cell to use
+    unsigned int existingCellSize = cellSize < cellSize_ ? cellSize : cellSize_;
 
-    // Free old array
-    free(commands_);
+    // Copy the notes and the remaining command pages of the allocated chunks to new chunks
+    for (int index = 0; index < chunks_.count(); index++) {
+        unsigned char *oldChunk = chunks_[index];
+        if (oldChunk != NULL) {
+            unsigned char *chunk = (unsigned char *)calloc(CHUNK_LINES * tracks_ * cellSize, sizeof(unsigned char));
+            for (unsigned int position = 0; position < CHUNK_LINES * tracks_; position++) {
+                memcpy(chunk + position * cellSize, oldChunk + position * cellSize_, existingCellSize);
+            }
+            free(oldChunk);
+            chunks_[index] = chunk;
+        }
+    }
 
-    // Use new array
-    commands_ = commands;
+    cellSize_ = cellSize;
     commandPages_ = commandPages;
 
+    // The removed command pages may have been all there was in some chunks
+    if (commandPages < oldCommandPages) {
+        releaseEmptyChunks(0, length_ - 1);
+    }
+
     emit commandPagesChanged(commandPages_);
     emit areaChanged(0, 0, tracks_ - 1, length_ - 1);
 }
 
-unsigned char Block::note(unsigned int line, unsigned int track)
-{
-    return notes_[2 * (tracks_ * line + track)];
-}
-
 void Block::setNote(unsigned int line, unsigned int track, unsigned char octave, unsigned char note, unsigned char instrument)
 {
-    if (note != 0) {
-        notes_[2 * (tracks_ * line + track)] = octave * 12 + note;
-        notes_[2 * (tracks_ * line + track) + 1] = instrument;
-    } else {
-        notes_[2 * (tracks_ * line + track)] = 0;
-        notes_[2 * (tracks_ * line + track) + 1] = 0;
+    // Clearing a line without storage changes nothing
+    unsigned char *data = note != 0 ? writableCell(line, track) : cell(line, track);
+    if (data != NULL) {
+        if (note != 0) {
+            data[0] = octave * 12 + note;
+            data[1] = instrument;
+        } else {
+            data[0] = 0;
+            data[1] = 0;
+        }
     }
 
     emit areaChanged(track, line, track, line);
@@ -182,42 +186,37 @@ void Block::setNote(unsigned int line, unsigned int track, unsigned char octave,
 
 void Block::setNoteFull(unsigned int line, unsigned int track, unsigned char note, unsigned char instrument)
 {
-    notes_[2 * (tracks_ * line + track)] = note;
-    notes_[2 * (tracks_ * line + track) + 1] = instrument;
+    unsigned char *data = note != 0 || instrument != 0 ? writableCell(line, track) : cell(line, track);
+    if (data != NULL) {
+        data[0] = note;
+        data[1] = instrument;
+    }
 
     emit areaChanged(track, line, track, line);
 }
 
-unsigned char Block::instrument(unsigned int line, unsigned int track)
-{
-    return notes_[2 * (tracks_ * line + track) + 1];
-}
-
 void Block::setInstrument(unsigned int line, unsigned int track, unsigned char instrument)
 {
-    notes_[2 * (tracks_ * line + track) + 1] = instrument;
+    unsigned char *data = instrument != 0 ? writableCell(line, track) : cell(line, track);
+    if (data != NULL) {
+        data[1] = instrument;
+    }
 
     emit areaChanged(track, line, track, line);
 }
 
-unsigned char Block::command(unsigned int line, unsigned int track, unsigned int commandPage)
-{
-    return commands_[commandPage * 2 * tracks_ * length_ + 2 * (tracks_ * line + track)];
-}
-
-unsigned char Block::commandValue(unsigned int line, unsigned int track, unsigned int commandPage)
-{
-    return commands_[commandPage * 2 * tracks_ * length_ + 2 * (tracks_ * line + track) + 1];
-}
-
 void Block::setCommand(unsigned int line, unsigned int track, unsigned int commandPage, unsigned char slot, unsigned char data)
 {
-    if ((slot & 1) != 0) {
-        commands_[commandPage * 2 * tracks_ * length_ + 2 * (tracks_ * line + track) + slot / 2] &= 0xf0;
-        commands_[commandPage * 2 * tracks_ * length_ + 2 * (tracks_ * line + track) + slot / 2] |= data;
-    } else {
-        commands_[commandPage * 2 * tracks_ * length_ + 2 * (tracks_ * line + track) + slot / 2] &= 0x0f;
-        commands_[commandPage * 2 * tracks_ * length_ + 2 * (tracks_ * line + track) + slot / 2] |= (data << 4);
+    unsigned char *cell = data != 0 ? writableCell(line, track) : this->cell(line, track);
+    if (cell != NULL) {
+        unsigned char *command = cell + 2 + 2 * commandPage + slot / 2;
+        if ((slot & 1) != 0) {
+            *command &= 0xf0;
+            *command |= data;
+        } else {
+            *command &= 0x0f;
+            *command |= (data << 4);
+        }
     }
 
     emit areaChanged(track, line, track, line);
@@ -225,8 +224,11 @@ void Block::setCommand(unsigned int line, unsigned int track, unsigned int comma
 
 void Block::setCommandFull(unsigned int line, unsigned int track, unsigned int commandPage, unsigned char command, unsigned char data)
 {
-    commands_[commandPage * 2 * tracks_ * length_ + 2 * (tracks_ * line + track)] = command;
-    commands_[commandPage * 2 * tracks_ * length_ + 2 * (tracks_ * line + track) + 1] = data;
+    unsigned char *cell = command != 0 || data != 0 ? writableCell(line, track) : this->cell(line, track);
+    if (cell != NULL) {
+        cell[2 + 2 * commandPage] = command;
+        cell[3 + 2 * commandPage] = data;
+    }
 
     emit areaChanged(track, line, track, line);
 }
@@ -237,22 +239,17 @@ Block *Block::copy(int startTrack, int startLine, int endTrack, int endLine)
 
     // Allocate new block
     Block *newBlock = new Block(endTrack - startTrack + 1, endLine - startLine + 1, commandPages_);
-    unsigned int oldLength = length_;
-    unsigned int newLength = newBlock->length_;
-    unsigned int oldTracks = tracks_;
-    unsigned int newTracks = newBlock->tracks_;
 
-    // Copy the given part of the block to a new block
+    // Copy the given part of the block to a new block; the cells of the tracks on a line are contiguous
     for (int line = startLine; line <= endLine; line++) {
-        for (int track = startTrack; track <= endTrack; track++) {
-            newBlock->notes_[((line - startLine) * newTracks + (track - startTrack)) * 2] = notes_[(line * oldTracks + track) * 2];
-            newBlock->notes_[((line - startLine) * newTracks + (track - startTrack)) * 2 + 1] = notes_[(line * oldTracks + track) * 2 + 1];
-            for (unsigned int commandPage = 0; commandPage < commandPages_; commandPage++) {
-                newBlock->commands_[commandPage * 2 * newTracks * newLength + ((line - startLine) * newTracks + (track - startTrack)) * 2] = commands_[commandPage * 2 * oldTracks * oldLength + (line * oldTracks + track) * 2];
-                newBlock->commands_[commandPage * 2 * newTracks * newLength + ((line - startLine) * newTracks + (track - startTrack)) * 2 + 1] = commands_[commandPage * 2 * oldTracks * oldLength + (line * oldTracks + track) * 2 + 1];
-            }
+        const unsigned char *data = cell(line, startTrack);
+        if (data != NULL) {
+            memcpy(newBlock->writableCell(line - startLine, 0), data, newBlock->tracks_ * cellSize_);
         }
     }
+    newBlock->releaseEmptyChunks(0, newBlock->length_ - 1);
+
+    newBlock->compileTimeline(0, newBlock->length_ - 1);
 
     return newBlock;
 }
@@ -280,17 +277,37 @@ void Block::paste(Block *from, int track, int line)
     }
 
     // Copy the from block to the destination block; make sure it fits
+    unsigned int copyCellSize = 2 + 2 * copyCommandPages;
     for (int l = 0; l < copyLength; l++) {
-        for (int t = 0; t < copyTracks; t++) {
-            notes_[((line + l) * toTracks + (track + t)) * 2] = from->notes_[(l * fromTracks + t) * 2];
-            notes_[((line + l) * toTracks + (track + t)) * 2 + 1] = from->notes_[(l * fromTracks + t) * 2 + 1];
-            for (int ep = 0; ep < copyCommandPages; ep++) {
-                commands_[ep * 2 * toTracks * toLength + ((line + l) * toTracks + (track + t)) * 2] = from->commands_[ep * 2 * fromTracks * fromLength + (l * fromTracks + t) * 2];
-                commands_[ep * 2 * toTracks * toLength + ((line + l) * toTracks + (track + t)) * 2 + 1] = from->commands_[ep * 2 * fromTracks * fromLength + (l * fromTracks + t) * 2 + 1];
+        // Empty lines pasted on lines without storage change nothing
+        if (!from->isLineAllocated(l) && !isLineAllocated(line + l)) {
+            continue;
+        }
+
+        if (copyTracks > 0 && copyCellSize == cellSize_ && copyCellSize == from->cellSize_) {
+            // The cells of the tracks on a line can be copied at once if they are of the same size
+            const unsigned char *data = from->cell(l, 0);
+            if (data != NULL) {
+                memcpy(writableCell(line + l, track), data, copyTracks * cellSize_);
+            } else {
+                memset(cell(line + l, track), 0, copyTracks * cellSize_);
+            }
+        } else {
+            for (int t = 0; t < copyTracks; t++) {
+                const unsigned char *data = from->cell(l, t);
+                if (data != NULL) {
+                    memcpy(writableCell(line + l, track + t), data, copyCellSize);
+                } else {
+                    memset(cell(line + l, track + t), 0, copyCellSize);
+                }
             }
         }
     }
 
+    if (copyLength > 0) {
+        releaseEmptyChunks(line, line + copyLength - 1);
+    }
+
     emit areaChanged(track, line, track + copyTracks - 1, line + copyLength - 1);
 }
 
@@ -299,15 +316,12 @@ void Block::clear(int startTrack, int startLine, int endTrack, int endLine)
     checkBounds(startTrack, startLine, endTrack, endLine);
 
     for (int line = startLine; line <= endLine; line++) {
-        for (int track = startTrack; track <= endTrack; track++) {
-            notes_[(line * tracks_ + track) * 2] = 0;
-            notes_[(line * tracks_ + track) * 2 + 1] = 0;
-            for (unsigned int commandPage = 0; commandPage < commandPages_; commandPage++) {
-                commands_[commandPage * 2 * tracks_ * length_ + (line * tracks_ + track) * 2] = 0;
-                commands_[commandPage * 2 * tracks_ * length_ + (line * tracks_ + track) * 2 + 1] = 0;
-            }
+        unsigned char *data = cell(line, startTrack);
+        if (data != NULL) {
+            memset(data, 0, (endTrack - startTrack + 1) * cellSize_);
         }
     }
+    releaseEmptyChunks(startLine, endLine);
 
     emit areaChanged(startTrack, startLine, endTrack, endLine);
 }
@@ -320,13 +334,14 @@ void Block::transpose(int instrument, int halfNotes, int startTrack, int startLi
     if (instrument < 0) {
         for (int line = startLine; line <= endLine; line++) {
             for (int track = startTrack; track <= endTrack; track++) {
-                if (notes_[(line * tracks_ + track) * 2] > 0) {
-                    if (notes_[(line * tracks_ + track) * 2] + halfNotes < 1) {
-                        notes_[(line * tracks_ + track) * 2] = 1;
-                    } else if (notes_[(line * tracks_ + track) * 2] + halfNotes > 127) {
-                        notes_[(line * tracks_ + track) * 2] = 127;
+                unsigned char *data = cell(line, track);
+                if (data != NULL && data[0] > 0) {
+                    if (data[0] + halfNotes < 1) {
+                        data[0] = 1;
+                    } else if (data[0] + halfNotes > 127) {
+                        data[0] = 127;
                     } else {
-                        notes_[(line * tracks_ + track) * 2] += halfNotes;
+                        data[0] += halfNotes;
                     }
                 }
             }
@@ -334,13 +349,14 @@ void Block::transpose(int instrument, int halfNotes, int startTrack, int startLi
     } else {
         for (int line = startLine; line <= endLine; line++) {
             for (int track = startTrack; track <= endTrack; track++) {
-                if (notes_[(line * tracks_ + track) * 2] > 0 && notes_[(line * tracks_ + track) * 2 + 1] == instrument + 1) {
-                    if (notes_[(line * tracks_ + track) * 2] + halfNotes < 0) {
-                        notes_[(line * tracks_ + track) * 2] = 1;
-                    } else if (notes_[(line * tracks_ + track) * 2] + halfNotes > 127) {
-                        notes_[(line * tracks_ + track) * 2] = 127;
+                unsigned char *data = cell(line, track);
+                if (data != NULL && data[0] > 0 && data[1] == instrument + 1) {
+                    if (data[0] + halfNotes < 0) {
+                        data[0] = 1;
+                    } else if (data[0] + halfNotes > 127) {
+                        data[0] = 127;
                     } else {
-                        notes_[(line * tracks_ + track) * 2] += halfNotes;
+                        data[0] += halfNotes;
                     }
                 }
             }
@@ -366,14 +382,7 @@ void Block::expandShrink(int factor, int startTrack, int startLine, int endTrack
         {
             int newEndLine = startLine + (endLine + 1 - startLine) / -factor - 1;
             for (int line = startLine; line <= newEndLine; line++) {
-                for (int track = startTrack; track <= endTrack; track++) {
-                    notes_[(line * tracks_ + track) * 2] = notes_[((startLine + (line - startLine) * -factor) * tracks_ + track) * 2];
-                    notes_[(line * tracks_ + track) * 2 + 1] = notes_[((startLine + (line - startLine) * -factor) * tracks_ + track) * 2 + 1];
-                    for (unsigned int commandPage = 0; commandPage < commandPages_; commandPage++) {
-                        commands_[commandPage * tracks_ * length_ * 2 + (line * tracks_ + track) * 2] = commands_[commandPage * tracks_ * length_ * 2 + ((startLine + (line - startLine) * -factor) * tracks_ + track) * 2];
-                        commands_[commandPage * tracks_ * length_ * 2 + (line * tracks_ + track) * 2 + 1] = commands_[commandPage * tracks_ * length_ * 2 + ((startLine + (line - startLine) * -factor) * tracks_ + track) * 2 + 1];
-                    }
-                }
+                copyLine(line, startLine + (line - startLine) * -factor, startTrack, endTrack);
             }
 
             if (changeBlockLength) {
@@ -397,25 +406,15 @@ void Block::expandShrink(int factor, int startTrack, int startLine, int endTrack
 
         for (int line = endLine; line >= startLine; line--) {
             if ((line - startLine) % factor == 0) {
-                for (int track = startTrack; track <= endTrack; track++) {
-                    notes_[(line * tracks_ + track) * 2] = notes_[((startLine + (line - startLine) / factor) * tracks_ + track) * 2];
-                    notes_[(line * tracks_ + track) * 2 + 1] = notes_[((startLine + (line - startLine) / factor) * tracks_ + track) * 2 + 1];
-                    for (unsigned int commandPage = 0; commandPage < commandPages_; commandPage++) {
-                        commands_[commandPage * tracks_ * length_ * 2 + (line * tracks_ + track) * 2] = commands_[commandPage * tracks_ * length_ * 2 + ((startLine + (line - startLine) / factor) * tracks_ + track) * 2];
-                        commands_[commandPage * tracks_ * length_ * 2 + (line * tracks_ + track) * 2 + 1] = commands_[commandPage * tracks_ * length_ * 2 + ((startLine + (line - startLine) / factor) * tracks_ + track) * 2 + 1];
-                    }
-                }
+                copyLine(line, startLine + (line - startLine) / factor, startTrack, endTrack);
             } else {
-                for (int track = startTrack; track <= endTrack; track++) {
-                    notes_[(line * tracks_ + track) * 2] = 0;
-                    notes_[(line * tracks_ + track) * 2 + 1] = 0;
-                    for (unsigned int commandPage = 0; commandPage < commandPages_; commandPage++) {
-                        commands_[commandPage * tracks_ * length_ * 2 + (line * tracks_ + track) * 2] = 0;
-                        commands_[commandPage * tracks_ * length_ * 2 + (line * tracks_ + track) * 2 + 1] = 0;
-                    }
+                unsigned char *data = cell(line, startTrack);
+                if (data != NULL) {
+                    memset(data, 0, (endTrack - startTrack + 1) * cellSize_);
                 }
             }
         }
+        releaseEmptyChunks(startLine, endLine);
     }
 
     emit areaChanged(startTrack, startLine, endTrack, endLine);
@@ -428,18 +427,24 @@ void Block::changeInstrument(int from, int to, bool swap, int startTrack, int st
     if (swap) {
         for (int line = endLine; line >= startLine; line--) {
             for (int track = startTrack; track <= endTrack; track++) {
-                if (notes_[(line * tracks_ + track) * 2 + 1] == from) {
-                    notes_[(line * tracks_ + track) * 2 + 1] = to;
-                } else if (notes_[(line * tracks_ + track) * 2 + 1] == to) {
-                    notes_[(line * tracks_ + track) * 2 + 1] = from;
+                unsigned char *data = cell(line, track);
+                if (data == NULL) {
+                    continue;
+                }
+
+                if (data[1] == from) {
+                    data[1] = to;
+                } else if (data[1] == to) {
+                    data[1] = from;
                 }
             }
         }
     } else {
         for (int line = endLine; line >= startLine; line--) {
             for (int track = startTrack; track <= endTrack; track++) {
-                if (notes_[(line * tracks_ + track) * 2 + 1] == from) {
-                    notes_[(line * tracks_ + track) * 2 + 1] = to;
+                unsigned char *data = cell(line, track);
+                if (data != NULL && data[1] == from) {
+                    data[1] = to;
                 }
             }
         }
@@ -546,8 +551,9 @@ Block *Block::parse(QDomElement element)
             commandpages = prop.value().toInt();
         }
 
-        // Allocate block
+        // Allocate block; the timeline is compiled once the contents have been parsed
         block = new Block(tracks, length, commandpages);
+        block->blockSignals(true);
         prop = element.attributeNode("name");
         if (!prop.isNull()) {
             block->name_ = prop.value();
@@ -612,6 +618,9 @@ Block *Block::parse(QDomElement element)
             }
             cur = cur.nextSibling().toElement();
         }
+
+        block->blockSignals(false);
+        block->compileTimeline(0, block->length_ - 1);
     } else if (element.nodeType() != QDomNode::CommentNode) {
         qWarning("XML error: expected block, got %s\n", element.tagName().toUtf8().constData());
     }
@@ -631,15 +640,21 @@ void Block::save(int number, QDomElement &parentElement, QDomDocument &document)
     blockElement.setAttribute("commandpages", commandPages_);
     blockElement.appendChild(document.createTextNode("\n"));
 
-    // Notation data
+    // Notation data; lines without storage are skipped a chunk at a time
     for (int track = 0; track < tracks_; track++) {
         for (int line = 0; line < length_; line++) {
-            if (notes_[2 * (tracks_ * line + track)] != 0 || notes_[2 * (tracks_ * line + track) + 1] != 0) {
+            const unsigned char *data = cell(line, track);
+            if (data == NULL) {
+                line += CHUNK_LINES - 1 - line % CHUNK_LINES;
+                continue;
+            }
+
+            if (data[0] != 0 || data[1] != 0) {
                 QDomElement noteElement = document.createElement("note");
-                noteElement.appendChild(document.createTextNode(QString("%1").arg(notes_[2 * (tracks_ * line + track)])));
+                noteElement.appendChild(document.createTextNode(QString("%1").arg(data[0])));
                 noteElement.setAttribute("line", line);
                 noteElement.setAttribute("track", track);
-                noteElement.setAttribute("instrument", notes_[2 * (tracks_ * line + track) + 1]);
+                noteElement.setAttribute("instrument", data[1]);
                 blockElement.appendChild(noteElement);
                 blockElement.appendChild(document.createTextNode("\n"));
             }
@@ -649,14 +664,21 @@ void Block::save(int number, QDomElement &parentElement, QDomDocument &document)
     // Command data
     for (int track = 0; track < tracks_; track++) {
         for (int line = 0; line < length_; line++) {
+            const unsigned char *data = cell(line, track);
+            if (data == NULL) {
+                line += CHUNK_LINES - 1 - line % CHUNK_LINES;
+                continue;
+            }
+
             for (int commandPage = 0; commandPage < commandPages_; commandPage++) {
-                if (commands_[commandPage * 2 * tracks_ * length_ + 2 * (tracks_ * line + track)] != 0 || commands_[commandPage * 2 * tracks_ * length_ + 2 * (tracks_ * line + track) + 1] != 0) {
+                const unsigned char *command = data + 2 + 2 * commandPage;
+                if (command[0] != 0 || command[1] != 0) {
                     QDomElement commandElement = document.createElement("command");
-                    commandElement.appendChild(document.createTextNode(QString("%1").arg(commands_[commandPage * 2 * tracks_ * length_ + 2 * (tracks_ * line + track)])));
+                    commandElement.appendChild(document.createTextNode(QString("%1").arg(command[0])));
                     commandElement.setAttribute("line", line);
                     commandElement.setAttribute("track", track);
                     commandElement.setAttribute("commandpage", commandPage);
-                    commandElement.setAttribute("value", commands_[commandPage * 2 * tracks_ * length_ + 2 * (tracks_ * line + track) + 1]);
+                    commandElement.setAttribute("value", command[1]);
                     blockElement.appendChild(commandElement);
                     blockElement.appendChild(document.createTextNode("\n"));
                 }
@@ -667,6 +689,69 @@ void Block::save(int number, QDomElement &parentElement, QDomDocument &document)
     parentElement.appendChild(document.createTextNode("\n"));
 }
 
+QSharedPointer<const BlockTimeline> Block::timeline() const
+{
+    return timeline_;
+}
+
+void Block::compileArea(int, int startLine, int, int endLine)
+{
+    compileTimeline(startLine < endLine ? startLine : endLine, startLine < endLine ? endLine : startLine);
+}
+
+void Block::compileTimeline(int startLine, int endLine)
+{
+    // The player may still be using the old timeline so compile the changes into a copy; unchanged lines are shared
+    BlockTimeline *timeline = timeline_.isNull() ? new BlockTimeline : new BlockTimeline(*timeline_);
+    timeline->compile(this, startLine, endLine);
+    timeline_ = QSharedPointer<const BlockTimeline>(timeline);
+}
+
+unsigned char *Block::writableCell(unsigned int line, unsigned int track)
+{
+    unsigned char *&chunk = chunks_[line / CHUNK_LINES];
+    if (chunk == NULL) {
+        chunk = (unsigned char *)calloc(CHUNK_LINES * tracks_ * cellSize_, sizeof(unsigned char));
+    }
+
+    return chunk + ((line % CHUNK_LINES) * tracks_ + track) * cellSize_;
+}
+
+void Block::copyLine(int toLine, int fromLine, int startTrack, int endTrack)
+{
+    unsigned int size = (endTrack - startTrack + 1) * cellSize_;
+    const unsigned char *data = cell(fromLine, startTrack);
+    if (data != NULL) {
+        memmove(writableCell(toLine, startTrack), data, size);
+    } else {
+        // The source is empty so only a line with storage needs clearing
+        unsigned char *to = cell(toLine, startTrack);
+        if (to != NULL) {
+            memset(to, 0, size);
+        }
+    }
+}
+
+void Block::releaseEmptyChunks(int startLine, int endLine)
+{
+    unsigned int size = CHUNK_LINES * tracks_ * cellSize_;
+
+    for (int index = startLine / CHUNK_LINES; index <= endLine / CHUNK_LINES && index < chunks_.count(); index++) {
+        unsigned char *chunk = chunks_[index];
+        if (chunk != NULL) {
+            unsigned int byte = 0;
+            while (byte < size && chunk[byte] == 0) {
+                byte++;
+            }
+
+            if (byte == size) {
+                free(chunk);
+                chunks_[index] = NULL;
+            }
+        }
+    }
+}
+
 void Block::checkBounds(int &startTrack, int &startLine, int &endTrack, int &endLine)
 {
     if (startTrack < 0) {
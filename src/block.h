@@ -25,6 +25,9 @@
 
 #include <QObject>
 #include <QString>
+#include <QSharedPointer>
+#include <QVector>
+#include "blocktimeline.h"
 
 class QDomElement;
 class QDomDocument;
@@ -33,6 +36,11 @@ class Block : public QObject {
     Q_OBJECT
 
 public:
+    // Number of lines stored together; storage is only allocated for the parts of a block that contain something
+    enum {
+        CHUNK_LINES = 16
+    };
+
     // Allocates a block
     Block(unsigned int tracks = 16, unsigned int length = 64, unsigned int commandPages = 1, QObject *parent = NULL);
     virtual ~Block();
@@ -62,7 +70,11 @@ public:
     void setCommandPages(unsigned int commandPages);
 
     // Gets a note from a block
-    unsigned char note(unsigned int line, unsigned int track);
+    unsigned char note(unsigned int line, unsigned int track)
+    {
+        const unsigned char *cell = this->cell(line, track);
+        return cell != NULL ? cell[0] : 0;
+    }
 
     // Sets a note in a block
     void setNote(unsigned int line, unsigned int track, unsigned char octave, unsigned char note, unsigned char instrument);
@@ -71,16 +83,28 @@ public:
     void setNoteFull(unsigned int line, unsigned int track, unsigned char note, unsigned char instrument);
 
     // Gets an instrument from a block
-    unsigned char instrument(unsigned int line, unsigned int track);
+    unsigned char instrument(unsigned int line, unsigned int track)
+    {
+        const unsigned char *cell = this->cell(line, track);
+        return cell != NULL ? cell[1] : 0;
+    }
 
     // Sets an instrument in a block
     void setInstrument(unsigned int line, unsigned int track, unsigned char instrument);
 
     // Gets a command from a block
-    unsigned char command(unsigned int line, unsigned int track, unsigned int commandPage);
+    unsigned char command(unsigned int line, unsigned int track, unsigned int commandPage)
+    {
+        const unsigned char *cell = this->cell(line, track);
+        return cell != NULL ? cell[2 + 2 * commandPage] : 0;
+    }
 
     // Gets a command value from a block
-    unsigned char commandValue(unsigned int line, unsigned int track, unsigned int commandPage);
+    unsigned char commandValue(unsigned int line, unsigned int track, unsigned int commandPage)
+    {
+        const unsigned char *cell = this->cell(line, track);
+        return cell != NULL ? cell[3 + 2 * commandPage] : 0;
+    }
 
     // Sets a part of a command in a block
     void setCommand(unsigned int line, unsigned int track, unsigned int commandPage, unsigned char slot, unsigned char data);
@@ -88,6 +112,12 @@ public:
     // Sets a command in a block
     void setCommandFull(unsigned int line, unsigned int track, unsigned int commandPage, unsigned char command, unsigned char data);
 
+    // Returns whether storage has been allocated for a line; lines without storage are empty
+    bool isLineAllocated(unsigned int line) const
+    {
+        return chunks_[line / CHUNK_LINES] != NULL;
+    }
+
     // Copies a part of a block to a new block
     Block *copy(int startTrack, int startLine, int endTrack, int endLine);
 
@@ -127,6 +157,9 @@ public:
     // Saves a block to an XML document
     void save(int number, QDomElement &parentElement, QDomDocument &document);
 
+    // Returns the compiled contents of the block for playback; the returned timeline is never modified
+    QSharedPointer<const BlockTimeline> timeline() const;
+
 signals:
     // Emitted when a part of the block changes
     void areaChanged(int startTrack, int startLine, int endTrack, int endLine);
@@ -143,22 +176,48 @@ signals:
     // Emitted when the name of the block changes
     void nameChanged(QString name);
 
+private slots:
+    // Recompiles the timeline for a changed part of the block
+    void compileArea(int startTrack, int startLine, int endTrack, int endLine);
+
 private:
     // Makes sure the given area is inside the block
     void checkBounds(int &startTrack, int &startLine, int &endTrack, int &endLine);
 
+    // Replaces the timeline with a new one in which the given lines have been recompiled
+    void compileTimeline(int startLine, int endLine);
+
+    // Returns the data of a track on a line; NULL if the line has no storage and is empty
+    unsigned char *cell(unsigned int line, unsigned int track) const
+    {
+        unsigned char *chunk = chunks_[line / CHUNK_LINES];
+        return chunk != NULL ? chunk + ((line % CHUNK_LINES) * tracks_ + track) * cellSize_ : NULL;
+    }
+
+    // Returns the data of a track on a line, allocating storage for the line if needed
+    unsigned char *writableCell(unsigned int line, unsigned int track);
+
+    // Copies the given tracks of a line to another line of the block
+    void copyLine(int toLine, int fromLine, int startTrack, int endTrack);
+
+    // Frees the storage of the chunks of the given lines that contain nothing
+    void releaseEmptyChunks(int startLine, int endLine);
+
     // Name
     QString name_;
     // Number of tracks
     unsigned int tracks_;
     // Number of lines
     unsigned int length_;
-    // Notation data
-    unsigned char *notes_;
     // Number of command pages
     unsigned int commandPages_;
-    // Command block array
-    unsigned char *commands_;
+    // Bytes in a cell: the note, the instrument and a command and a value for each command page
+    unsigned int cellSize_;
+    // Cells of the block in chunks of CHUNK_LINES lines, line by line so that everything on a line is read
+    // from one place; NULL for chunks that contain nothing
+    QVector<unsigned char *> chunks_;
+    // Compiled contents for playback
+    QSharedPointer<const BlockTimeline> timeline_;
 };
 
 #endif // BLOCK_H_
@@ -0,0 +1,112 @@
+/*
+ * blocktimeline.cpp
+ *
+ * Copyright 2002-2019 Vesa Halttunen
+ *
+ * This file is part of Tutka.
+ *
+ * Tutka is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tutka is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tutka; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "block.h"
+#include "blocktimeline.h"
+
+BlockTimeline::BlockTimeline() :
+    tracks_(0),
+    commandPages_(0)
+{
+}
+
+void BlockTimeline::compile(Block *block)
+{
+    tracks_ = block->tracks();
+    commandPages_ = block->commandPages();
+    lines_.resize(block->length());
+
+    for (unsigned int line = 0; line < block->length(); line++) {
+        compileLine(block, line);
+    }
+}
+
+void BlockTimeline::compile(Block *block, int startLine, int endLine)
+{
+    // If the dimensions of the block have changed everything needs to be recompiled
+    if (block->tracks() != tracks_ || block->commandPages() != commandPages_ || block->length() != lines_.count()) {
+        compile(block);
+        return;
+    }
+
+    if (startLine < 0) {
+        startLine = 0;
+    }
+    if (endLine >= (int)block->length()) {
+        endLine = block->length() - 1;
+    }
+
+    for (int line = startLine; line <= endLine; line++) {
+        compileLine(block, line);
+    }
+}
+
+unsigned int BlockTimeline::lines() const
+{
+    return lines_.count();
+}
+
+unsigned int BlockTimeline::tracks() const
+{
+    return tracks_;
+}
+
+const BlockTimeline::Line &BlockTimeline::line(unsigned int line) const
+{
+    return lines_.at(line);
+}
+
+void BlockTimeline::compileLine(Block *block, unsigned int line)
+{
+    Line &compiled = lines_[line];
+    compiled.cells.clear();
+    compiled.commands.clear();
+
+    // Lines without storage are empty
+    if (!block->isLineAllocated(line)) {
+        return;
+    }
+
+    for (unsigned int track = 0; track < tracks_; track++) {
+        Cell cell;
+        cell.track = track;
+        cell.note = block->note(line, track);
+        cell.instrument = block->instrument(line, track);
+        cell.firstCommand = compiled.commands.count();
+        cell.commands = 0;
+
+        // Only commands that are set are of interest
+        for (unsigned int commandPage = 0; commandPage < commandPages_; commandPage++) {
+            Command command;
+            command.command = block->command(line, track, commandPage);
+            command.value = block->commandValue(line, track, commandPage);
+            if (command.command != 0 || command.value != 0) {
+                compiled.commands.append(command);
+                cell.commands++;
+            }
+        }
+
+        if (cell.note != 0 || cell.instrument != 0 || cell.commands > 0) {
+            compiled.cells.append(cell);
+        }
+    }
+}
@@ -0,0 +1,89 @@
+/*
+ * blocktimeline.h
+ *
+ * Copyright 2002-2019 Vesa Halttunen
+ *
+ * This file is part of Tutka.
+ *
+ * Tutka is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tutka is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tutka; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef BLOCKTIMELINE_H_
+#define BLOCKTIMELINE_H_
+
+#include <QVector>
+
+class Block;
+
+// A compiled form of the contents of a block for playback. Each line lists
+// only the cells that contain something, and each cell only the commands that
+// are set, so the player does not have to scan empty tracks and command pages.
+class BlockTimeline {
+public:
+    // A command set in a cell
+    class Command {
+    public:
+        unsigned char command;
+        unsigned char value;
+    };
+
+    // A cell that has a note, an instrument or at least one command set
+    class Cell {
+    public:
+        unsigned int track;
+        unsigned char note;
+        unsigned char instrument;
+        // Index of the first command of the cell in the line's command array
+        unsigned short firstCommand;
+        // Number of commands the cell has
+        unsigned short commands;
+    };
+
+    // The non-empty cells of a line in track order
+    class Line {
+    public:
+        QVector<Cell> cells;
+        QVector<Command> commands;
+    };
+
+    BlockTimeline();
+
+    // Compiles all lines of a block
+    void compile(Block *block);
+
+    // Recompiles the given lines of a block
+    void compile(Block *block, int startLine, int endLine);
+
+    // Returns the number of compiled lines
+    unsigned int lines() const;
+
+    // Returns the number of tracks in the compiled block
+    unsigned int tracks() const;
+
+    // Returns a compiled line
+    const Line &line(unsigned int line) const;
+
+private:
+    // Compiles a single line of a block
+    void compileLine(Block *block, unsigned int line);
+
+    // Compiled lines
+    QVector<Line> lines_;
+    // Dimensions of the block when it was compiled
+    unsigned int tracks_;
+    unsigned int commandPages_;
+};
+
+#endif // BLOCKTIMELINE_H_
@@ -23,7 +23,9 @@
 #include "buffermidi.h"
 #include "buffermidiinterface.h"
 
-BufferMIDI::BufferMIDI(QObject *parent) : MIDI(parent)
+BufferMIDI::BufferMIDI(unsigned int outputs, QObject *parent) :
+    MIDI(parent),
+    outputCount(outputs > 0 ? outputs : 1)
 {
     updateInterfaces();
 }
@@ -35,12 +37,14 @@ BufferMIDI::~BufferMIDI()
 void BufferMIDI::updateInterfaces()
 {
     outputs_.clear();
-    outputs_.append(QSharedPointer<MIDIInterface>(new BufferMIDIInterface(this, MIDIInterface::Output)));
+    for (unsigned int output = 0; output < outputCount; output++) {
+        outputs_.append(QSharedPointer<MIDIInterface>(new BufferMIDIInterface(this, MIDIInterface::Output)));
+    }
     inputs_.clear();
     inputs_.append(QSharedPointer<MIDIInterface>(new BufferMIDIInterface(this, MIDIInterface::Input)));
 }
 
-QByteArray BufferMIDI::data() const
+QByteArray BufferMIDI::data(unsigned int output) const
 {
-    return static_cast<BufferMIDIInterface *>(outputs_[0].data())->data();
+    return static_cast<BufferMIDIInterface *>(outputs_[output].data())->data();
 }
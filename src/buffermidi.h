@@ -29,13 +29,18 @@
 class BufferMIDI : public MIDI
 {
 public:
-    BufferMIDI(QObject *parent = NULL);
+    BufferMIDI(unsigned int outputs = 1, QObject *parent = NULL);
     virtual ~BufferMIDI();
 
-    QByteArray data() const;
+    // Returns the data written to an output
+    QByteArray data(unsigned int output = 0) const;
 
 protected:
     virtual void updateInterfaces();
+
+private:
+    // Number of outputs to create
+    unsigned int outputCount;
 };
 
 #endif // BUFFERMIDI_H
@@ -46,6 +46,12 @@ void BufferMIDIInterface::tempo(unsigned int tempo)
     data[5] = ms & 0xff;
 
     write(data);
+    drain();
+}
+
+void BufferMIDIInterface::write(const MIDIMessage &message)
+{
+    writeEvent((const char *)message.data(), message.length());
 }
 
 void BufferMIDIInterface::write(const QByteArray &dataArray)
@@ -90,41 +96,52 @@ void BufferMIDIInterface::write(const QByteArray &dataArray)
 
         // Copy the rest of the data
         memcpy(newmessage + i + 1, data + 1, length - 1);
-        write(QByteArray(newmessage, length + l));
+        writeEvent(newmessage, length + l);
         delete [] newmessage;
     } else {
-        unsigned int delta = tick - oldTick;
-        oldTick = tick;
-        unsigned long value = delta;
-        unsigned long varlen = value & 0x7F;
-
-        // Create a variable length version of the tick delta
-        while ((value >>= 7)) {
-            varlen <<= 8;
-            varlen |= ((value & 0x7F) | 0x80);
-        }
+        writeEvent(data, length);
+    }
+}
 
-        // Check how many bytes the varlen version requires
-        value = varlen;
-        for (int i = 1; i <= 4; i++) {
-            if (value & 0x80)
-                value >>= 8;
-            else
-                break;
-        }
+void BufferMIDIInterface::writeEvent(const char *data, int length)
+{
+    unsigned int delta = tick - oldTick;
+    oldTick = tick;
+    unsigned long value = delta;
+    unsigned long varlen = value & 0x7F;
+
+    // Create a variable length version of the tick delta
+    while ((value >>= 7)) {
+        varlen <<= 8;
+        varlen |= ((value & 0x7F) | 0x80);
+    }
 
-        // Write the varlen tick delta value
-        for (int i = 1; i <= 4; i++) {
-            data_.append((unsigned char)(varlen & 0xff));
-            if (varlen & 0x80)
-                varlen >>= 8;
-            else
-                break;
-        }
+    // Check how many bytes the varlen version requires
+    value = varlen;
+    for (int i = 1; i <= 4; i++) {
+        if (value & 0x80)
+            value >>= 8;
+        else
+            break;
+    }
 
-        // Write the actual payload */
-        data_.append(data, length);
+    // Write the varlen tick delta value
+    for (int i = 1; i <= 4; i++) {
+        batch.append((unsigned char)(varlen & 0xff));
+        if (varlen & 0x80)
+            varlen >>= 8;
+        else
+            break;
     }
+
+    // Write the actual payload */
+    batch.append(data, length);
+}
+
+void BufferMIDIInterface::drain()
+{
+    data_.append(batch);
+    batch.resize(0);
 }
 
 QByteArray BufferMIDIInterface::data() const
@@ -37,11 +37,18 @@ public:
     virtual void tempo(unsigned int);
 
 protected:
+    virtual void write(const MIDIMessage &message);
     virtual void write(const QByteArray &data);
+    virtual void drain();
 
 private:
+    // Writes an event preceded by the delta time since the previous event
+    void writeEvent(const char *data, int length);
+
     BufferMIDI *midi;
     QByteArray data_;
+    // Messages written since the last drain
+    QByteArray batch;
     unsigned int oldTick;
 };
 
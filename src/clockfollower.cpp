@@ -0,0 +1,144 @@
+/*
+ * clockfollower.cpp
+ *
+ * Copyright 2002-2019 Vesa Halttunen
+ *
+ * This file is part of Tutka.
+ *
+ * Tutka is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tutka is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tutka; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <cmath>
+#include <time.h>
+#include "clockfollower.h"
+
+// Number of clocks the loop averages over once settled
+#define MAXIMUM_MEMORY 48
+// A gap of this many periods means the clock was stopped
+#define MAXIMUM_GAP 4
+// This many consecutive clocks outside the lock window mean the tempo changed
+#define MAXIMUM_OUTLIERS 2
+
+ClockFollower::ClockFollower() :
+    clocks_(0),
+    lockedClocks(0),
+    outliers(0),
+    phase(0),
+    period_(0),
+    jitter_(0)
+{
+}
+
+void ClockFollower::reset()
+{
+    clocks_ = 0;
+    lockedClocks = 0;
+    outliers = 0;
+    phase = 0;
+    period_ = 0;
+    jitter_ = 0;
+}
+
+void ClockFollower::clock(qint64 time)
+{
+    clocks_++;
+
+    // Start locking on the first clock or after the clock has been stopped for a while
+    if (lockedClocks == 0 || (lockedClocks >= 2 && time - phase > MAXIMUM_GAP * period_)) {
+        phase = time;
+        lockedClocks = 1;
+        outliers = 0;
+        return;
+    }
+
+    // The second clock gives the first estimate of the period
+    if (lockedClocks == 1) {
+        period_ = time - phase;
+        phase = time;
+        lockedClocks = 2;
+        return;
+    }
+
+    double predicted = phase + period_;
+    double error = time - predicted;
+
+    // A tempo change shows as consecutive errors larger than the jitter; relock quickly
+    if (std::fabs(error) > qMax(4 * jitter_, period_ / 8)) {
+        if (++outliers >= MAXIMUM_OUTLIERS) {
+            lockedClocks = 2;
+            outliers = 0;
+        }
+    } else {
+        outliers = 0;
+    }
+
+    // Gains of a least squares line fit over the clocks since locking, limited to the settled memory
+    double k = qMin(lockedClocks + 1, (qint64)MAXIMUM_MEMORY);
+    double alpha = 2 * (2 * k - 1) / (k * (k + 1));
+    double beta = 6 / (k * (k + 1));
+
+    phase = predicted + alpha * error;
+    period_ += beta * error;
+    if (lockedClocks >= 3) {
+        jitter_ += (std::fabs(error) - jitter_) / 16;
+    }
+    lockedClocks++;
+}
+
+qint64 ClockFollower::clocks() const
+{
+    return clocks_;
+}
+
+qint64 ClockFollower::clockTime(qint64 clock) const
+{
+    // Play immediately until there is an estimate of the period
+    if (lockedClocks < 2) {
+        return (qint64)phase;
+    }
+
+    // Delay by the jitter so that most clocks have arrived by the time they are played
+    double latency = qMin(3 * jitter_, period_ / 2);
+    return (qint64)(phase + (clock - clocks_) * period_ + latency);
+}
+
+qint64 ClockFollower::period() const
+{
+    return lockedClocks >= 2 ? (qint64)period_ : 0;
+}
+
+qint64 ClockFollower::jitter() const
+{
+    return (qint64)jitter_;
+}
+
+qint64 ClockFollower::currentTime()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (qint64)time.tv_sec * 1000000000 + time.tv_nsec;
+}
+
+void ClockFollower::sleepUntil(qint64 time)
+{
+    qint64 remaining = time - currentTime();
+    while (remaining > 0) {
+        struct timespec req;
+        req.tv_sec = remaining / 1000000000;
+        req.tv_nsec = remaining % 1000000000;
+        nanosleep(&req, NULL);
+        remaining = time - currentTime();
+    }
+}
@@ -0,0 +1,78 @@
+/*
+ * clockfollower.h
+ *
+ * Copyright 2002-2019 Vesa Halttunen
+ *
+ * This file is part of Tutka.
+ *
+ * Tutka is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tutka is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tutka; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef CLOCKFOLLOWER_H
+#define CLOCKFOLLOWER_H
+
+#include <QtGlobal>
+
+// Recovers the timing of an external MIDI clock with a phase-locked loop.
+// The time and period of the clock are estimated from the arrival times of
+// the clock messages so that ticks can be played at the smoothed times
+// instead of passing the jitter of the incoming clock straight to the
+// outputs. Right after locking and after a tempo change the loop follows
+// the clock closely and settles to heavier smoothing as the clock stays
+// steady.
+class ClockFollower {
+public:
+    ClockFollower();
+
+    // Forgets the clock; the following clocks lock to the clock again
+    void reset();
+
+    // Records a clock received at the given CLOCK_MONOTONIC time in nanoseconds
+    void clock(qint64 time);
+
+    // Returns the number of clocks received since reset
+    qint64 clocks() const;
+
+    // Returns the CLOCK_MONOTONIC time the given clock should be played at; clocks are numbered from 1 since reset
+    qint64 clockTime(qint64 clock) const;
+
+    // Returns the estimated time between clocks in nanoseconds; 0 until locked
+    qint64 period() const;
+
+    // Returns the estimated jitter of the incoming clock in nanoseconds
+    qint64 jitter() const;
+
+    // Returns the current CLOCK_MONOTONIC time in nanoseconds
+    static qint64 currentTime();
+
+    // Sleeps until the given CLOCK_MONOTONIC time in nanoseconds
+    static void sleepUntil(qint64 time);
+
+private:
+    // Clocks received since reset
+    qint64 clocks_;
+    // Clocks received since the loop locked; selects the loop gains
+    qint64 lockedClocks;
+    // Consecutive clocks outside the lock window
+    int outliers;
+    // Estimated time of the latest clock
+    double phase;
+    // Estimated time between clocks
+    double period_;
+    // Mean absolute phase error
+    double jitter_;
+};
+
+#endif // CLOCKFOLLOWER_H
@@ -20,6 +20,7 @@
  */
 
 #include <QByteArray>
+#include <QFile>
 #include <cstring>
 #include "song.h"
 #include "track.h"
@@ -559,24 +560,81 @@ struct MMD2 *songToMMD2(Song *song)
     return mmd;
 }
 
+Song *loadSong(const QString &path)
+{
+    QFile file(path);
+    if (file.exists()) {
+        file.open(QIODevice::ReadOnly);
+        QByteArray header = file.read(4);
+        if (header.length() == 4) {
+            const char *data = header.data();
+            if (data[0] == (ID_MMD2 >> 24) && data[1] == ((ID_MMD2 >> 16) & 0xff) && data[2] == ((ID_MMD2 >> 8) & 0xff) && (data[3] == (ID_MMD0 & 0xff) || data[3] == (ID_MMD1 & 0xff) || data[3] == (ID_MMD2 & 0xff))) {
+                Song *song = mmd2ToSong(MMD2_load(path.toUtf8().constData()));
+                if (song != NULL) {
+                    return song;
+                }
+            }
+        }
+    }
+
+    return new Song(path);
+}
+
+// Creates a track name meta event at the beginning of a standard MIDI file track
+static QByteArray smfTrackName(const QString &name)
+{
+    QByteArray text = name.toUtf8().left(127);
+    QByteArray data;
+    data.append((char)0x00);
+    data.append((char)0xff);
+    data.append((char)0x03);
+    data.append((char)text.length());
+    data.append(text);
+    return data;
+}
+
 // Converts a song to a standard MIDI file
-SMF *songToSMF(Song *song)
+SMF *songToSMF(Song *song, Player::ExportOutputs exportOutputs, unsigned int *ticks)
 {
     if (song == NULL) {
         return NULL;
     }
 
-    SMF *smf = new SMF;
-    BufferMIDI *midi = new BufferMIDI;
+    // Output 0 gets the events not tied to a track or an instrument, such as tempo changes
+    unsigned int outputs = 1;
+    if (exportOutputs == Player::ExportOutputsPerTrack) {
+        outputs += song->maxTracks();
+    } else if (exportOutputs == Player::ExportOutputsPerInstrument) {
+        outputs += song->instruments();
+    }
+
+    SMF *smf = new SMF(outputs > 1 ? 1 : 0);
+    BufferMIDI *midi = new BufferMIDI(outputs);
     Player *player = new Player(midi, song, true);
     QMetaObject::invokeMethod(player, "init");
-    player->playWithoutScheduling();
+    player->playWithoutScheduling(exportOutputs);
     char endMTrk[3];
     endMTrk[0] = 0xff;
     endMTrk[1] = 0x2f;
     endMTrk[2] = 0x00;
-    midi->output(0)->writeRaw(QByteArray(endMTrk, 3));
-    smf->addTrack(midi->data());
+    for (unsigned int output = 0; output < outputs; output++) {
+        // Tracks and instruments that were never played get no track of their own
+        if (output > 0 && midi->data(output).isEmpty()) {
+            continue;
+        }
+
+        midi->output(output)->writeRaw(QByteArray(endMTrk, 3));
+        if (output == 0) {
+            smf->addTrack(outputs > 1 ? smfTrackName(song->name()) + midi->data(output) : midi->data(output));
+        } else if (exportOutputs == Player::ExportOutputsPerTrack) {
+            smf->addTrack(smfTrackName(song->track(output - 1)->name()) + midi->data(output));
+        } else {
+            smf->addTrack(smfTrackName(song->instrument(output - 1)->name()) + midi->data(output));
+        }
+    }
+    if (ticks != NULL) {
+        *ticks = player->ticksPlayed();
+    }
     delete player;
     delete midi;
 
@@ -22,17 +22,23 @@
 #ifndef CONVERSION_H
 #define CONVERSION_H
 
+#include "player.h"
+
+class QString;
 class Song;
 class SMF;
 struct MMD2;
 
+// Loads a song from a Tutka or an MMD file
+Song *loadSong(const QString &path);
+
 // Converts an MMD2 module to a song
 Song *mmd2ToSong(MMD2 *mmd);
 
 // Converts a song to an MMD2 module
 MMD2 *songToMMD2(Song *song);
 
-// Converts a song to a standard MIDI file
-SMF *songToSMF(Song *song);
+// Converts a song to a standard MIDI file; a format 1 file is created if events are split to multiple tracks
+SMF *songToSMF(Song *song, Player::ExportOutputs exportOutputs = Player::ExportOutputsSingle, unsigned int *ticks = NULL);
 
 #endif // CONVERSION_H
@@ -1,5 +1,6 @@
 #include "coremidiinterface.h"
 #include "coremidi.h"
+#include "clockfollower.h"
 
 CoreMIDI::CoreMIDI(QObject *parent) :
     MIDI(parent)
@@ -50,9 +51,13 @@ void CoreMIDI::readMidi(const MIDIPacketList *pktlist, void *readProcRefCon, voi
     Q_UNUSED(srcConnRefCon)
 
     CoreMIDI *midi = (CoreMIDI *)readProcRefCon;
-    for (int packet = 0; packet < pktlist->numPackets; packet++) {
-        emit midi->inputReceived(QByteArray((const char *)pktlist->packet[packet].data, pktlist->packet[packet].length));
+    qint64 time = ClockFollower::currentTime();
+    const MIDIPacket *packet = &pktlist->packet[0];
+    for (unsigned int index = 0; index < pktlist->numPackets; index++) {
+        midi->queueInput(packet->data, packet->length, time);
+        packet = MIDIPacketNext(packet);
     }
+    midi->commitInput();
 }
 
 void CoreMIDI::handleMidiNotification(const MIDINotification *message, void *refCon)
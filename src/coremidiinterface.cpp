@@ -31,6 +31,18 @@ CoreMIDIInterface::CoreMIDIInterface(CoreMIDI *midi, MIDIEndpointRef endpoint, D
     name_ = getMidiDeviceName(endpoint);
 }
 
+void CoreMIDIInterface::write(const MIDIMessage &message)
+{
+    MIDIPacketList list;
+    list.numPackets = 1;
+    list.packet[0].timeStamp = 0;
+    list.packet[0].length = message.length();
+    memcpy(list.packet[0].data, message.data(), message.length());
+
+    MIDISend(midi->outputPort, endpoint, &list);
+    MIDIReceived(midi->source, &list);
+}
+
 void CoreMIDIInterface::write(const QByteArray &data)
 {
     MIDIPacketList list;
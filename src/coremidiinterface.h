@@ -33,6 +33,7 @@ class CoreMIDIInterface : public MIDIInterface
 public:
     CoreMIDIInterface(CoreMIDI *midi, MIDIEndpointRef endpoint, DirectionFlags flags, QObject *parent = NULL);
 
+    virtual void write(const MIDIMessage &message);
     virtual void write(const QByteArray &data);
     virtual void setEnabled(bool enabled);
 
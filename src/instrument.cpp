@@ -64,7 +64,11 @@ unsigned int Instrument::midiInterface() const
 
 void Instrument::setMidiInterface(int interface)
 {
-    midiInterface_ = interface;
+    if (midiInterface_ != (unsigned int)interface) {
+        midiInterface_ = interface;
+
+        emit routingChanged();
+    }
 }
 
 QString Instrument::midiInterfaceName() const
@@ -89,7 +93,11 @@ unsigned char Instrument::midiChannel() const
 
 void Instrument::setMidiChannel(int midiChannel)
 {
-    midiChannel_ = midiChannel;
+    if (midiChannel_ != (unsigned char)midiChannel) {
+        midiChannel_ = midiChannel;
+
+        emit routingChanged();
+    }
 }
 
 unsigned char Instrument::defaultVelocity() const
@@ -113,7 +121,11 @@ char Instrument::transpose() const
 
 void Instrument::setTranspose(int transpose)
 {
-    transpose_ = transpose;
+    if (transpose_ != transpose) {
+        transpose_ = transpose;
+
+        emit transposeChanged(transpose_);
+    }
 }
 
 unsigned char Instrument::hold() const
@@ -123,7 +135,11 @@ unsigned char Instrument::hold() const
 
 void Instrument::setHold(int hold)
 {
-    hold_ = hold;
+    if (hold_ != hold) {
+        hold_ = hold;
+
+        emit holdChanged(hold_);
+    }
 }
 
 Block *Instrument::arpeggio() const
@@ -133,7 +149,17 @@ Block *Instrument::arpeggio() const
 
 void Instrument::setArpeggio(Block *arpeggio)
 {
+    if (arpeggio_ != NULL) {
+        disconnect(arpeggio_, SIGNAL(areaChanged(int, int, int, int)), this, SIGNAL(arpeggioChanged()));
+    }
+
     arpeggio_ = arpeggio;
+
+    if (arpeggio_ != NULL) {
+        connect(arpeggio_, SIGNAL(areaChanged(int, int, int, int)), this, SIGNAL(arpeggioChanged()));
+    }
+
+    emit arpeggioChanged();
 }
 
 unsigned char Instrument::arpeggioBaseNote() const
@@ -143,7 +169,11 @@ unsigned char Instrument::arpeggioBaseNote() const
 
 void Instrument::setArpeggioBaseNote(int baseNote)
 {
-    arpeggioBaseNote_ = baseNote;
+    if (arpeggioBaseNote_ != baseNote) {
+        arpeggioBaseNote_ = baseNote;
+
+        emit arpeggioBaseNoteChanged(arpeggioBaseNote_);
+    }
 }
 
 Instrument *Instrument::parse(QDomElement element)
@@ -236,7 +266,7 @@ Instrument *Instrument::parse(QDomElement element)
                 // Parse and add all block elements
                 for (QDomElement temp = cur.firstChild().toElement(); !temp.isNull() && instrument->arpeggio_ == NULL; temp = temp.nextSibling().toElement()) {
                     if (temp.isElement()) {
-                        instrument->arpeggio_ = Block::parse(temp);
+                        instrument->setArpeggio(Block::parse(temp));
                     }
                 }
             }
@@ -108,6 +108,21 @@ signals:
     // Emitted when the default velocity has changed
     void defaultVelocityChanged(int defaultVelocity);
 
+    // Emitted when the arpeggio block or its contents have changed
+    void arpeggioChanged();
+
+    // Emitted when the MIDI interface or channel has changed
+    void routingChanged();
+
+    // Emitted when the transpose has changed
+    void transposeChanged(int transpose);
+
+    // Emitted when the hold has changed
+    void holdChanged(int hold);
+
+    // Emitted when the arpeggio base note has changed
+    void arpeggioBaseNoteChanged(int baseNote);
+
 private:
     // Name
     QString name_;
@@ -0,0 +1,144 @@
+/*
+ * latencyhistogram.cpp
+ *
+ * Copyright 2002-2019 Vesa Halttunen
+ *
+ * This file is part of Tutka.
+ *
+ * Tutka is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tutka is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tutka; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <QtAlgorithms>
+#include "latencyhistogram.h"
+
+LatencyHistogram::LatencyHistogram() :
+    count_(0),
+    overruns_(0),
+    maximum_(0)
+{
+    for (int bucket = 0; bucket < BUCKETS; bucket++) {
+        buckets[bucket].storeRelaxed(0);
+    }
+}
+
+void LatencyHistogram::record(qint64 nanoseconds, bool overrun)
+{
+    if (nanoseconds < 0) {
+        nanoseconds = 0;
+    }
+
+    buckets[bucket(nanoseconds / 1000)].fetchAndAddRelaxed(1);
+    count_.fetchAndAddRelaxed(1);
+    if (overrun) {
+        overruns_.fetchAndAddRelaxed(1);
+    }
+
+    // Only the player thread records, but the GUI may reset at the same time
+    qint64 maximum = maximum_.loadRelaxed();
+    while (nanoseconds > maximum && !maximum_.testAndSetRelaxed(maximum, nanoseconds, maximum)) { };
+}
+
+void LatencyHistogram::reset()
+{
+    for (int bucket = 0; bucket < BUCKETS; bucket++) {
+        buckets[bucket].storeRelaxed(0);
+    }
+    count_.storeRelaxed(0);
+    overruns_.storeRelaxed(0);
+    maximum_.storeRelaxed(0);
+}
+
+quint64 LatencyHistogram::count() const
+{
+    return count_.loadRelaxed();
+}
+
+qint64 LatencyHistogram::percentile(double fraction) const
+{
+    // The buckets may be updated while reading so the total is counted from the buckets themselves
+    quint32 counts[BUCKETS];
+    quint64 total = 0;
+    for (int bucket = 0; bucket < BUCKETS; bucket++) {
+        counts[bucket] = buckets[bucket].loadRelaxed();
+        total += counts[bucket];
+    }
+
+    if (total == 0) {
+        return 0;
+    }
+
+    quint64 target = (quint64)(fraction * total + 0.5);
+    if (target < 1) {
+        target = 1;
+    } else if (target > total) {
+        target = total;
+    }
+
+    quint64 counted = 0;
+    for (int bucket = 0; bucket < BUCKETS; bucket++) {
+        counted += counts[bucket];
+        if (counted >= target) {
+            // The bucket's upper bound, but never more than what has actually been seen
+            qint64 nanoseconds = (qint64)bucketMaximum(bucket) * 1000 + 999;
+            qint64 maximum = this->maximum();
+            return nanoseconds < maximum ? nanoseconds : maximum;
+        }
+    }
+
+    return maximum();
+}
+
+qint64 LatencyHistogram::maximum() const
+{
+    return maximum_.loadRelaxed();
+}
+
+quint64 LatencyHistogram::overruns() const
+{
+    return overruns_.loadRelaxed();
+}
+
+QString LatencyHistogram::summary() const
+{
+    return QString("p50 %1 us, p99 %2 us, max %3 us, %4/%5 overruns").arg(percentile(0.5) / 1000).arg(percentile(0.99) / 1000).arg(maximum() / 1000).arg(overruns()).arg(count());
+}
+
+int LatencyHistogram::bucket(quint64 microseconds)
+{
+    // Below 64 microseconds every microsecond has a bucket of its own
+    if (microseconds < 64) {
+        return microseconds;
+    }
+
+    int highestBit = 63 - qCountLeadingZeroBits(microseconds);
+    if (highestBit > 30) {
+        return BUCKETS - 1;
+    }
+
+    // Keep the six highest bits; the ones shifted out select the power of two
+    int shift = highestBit - 5;
+    return 32 * shift + (microseconds >> shift);
+}
+
+quint64 LatencyHistogram::bucketMaximum(int bucket)
+{
+    if (bucket < 64) {
+        return bucket;
+    }
+
+    int shift = bucket / 32 - 1;
+    quint64 mantissa = bucket - 32 * shift;
+    return ((mantissa + 1) << shift) - 1;
+}
@@ -0,0 +1,76 @@
+/*
+ * latencyhistogram.h
+ *
+ * Copyright 2002-2019 Vesa Halttunen
+ *
+ * This file is part of Tutka.
+ *
+ * Tutka is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tutka is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tutka; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <QAtomicInteger>
+#include <QString>
+
+// Counts durations (such as how late a scheduler woke up) into buckets
+// without locking, so the player thread can record every tick while the
+// GUI reads the statistics. Durations are stored in microseconds with
+// 32 buckets per power of two, so percentiles are accurate to about 3%.
+class LatencyHistogram {
+public:
+    // Number of buckets; durations up to 2^31 microseconds fit
+    enum {
+        BUCKETS = 896
+    };
+
+    LatencyHistogram();
+
+    // Records a duration in nanoseconds; negative durations are counted as zero
+    void record(qint64 nanoseconds, bool overrun = false);
+
+    // Forgets everything recorded so far
+    void reset();
+
+    // Returns the number of durations recorded
+    quint64 count() const;
+
+    // Returns the duration in nanoseconds the given fraction (0-1) of the recorded durations don't exceed
+    qint64 percentile(double fraction) const;
+
+    // Returns the longest duration recorded in nanoseconds
+    qint64 maximum() const;
+
+    // Returns the number of durations recorded as overruns
+    quint64 overruns() const;
+
+    // Returns the statistics as text, for example "p50 12 us, p99 130 us, max 1300 us, 0/2400 overruns"
+    QString summary() const;
+
+private:
+    // Returns the bucket of a duration in microseconds
+    static int bucket(quint64 microseconds);
+
+    // Returns the longest duration in microseconds that falls into a bucket
+    static quint64 bucketMaximum(int bucket);
+
+    QAtomicInteger<quint32> buckets[BUCKETS];
+    QAtomicInteger<quint64> count_;
+    QAtomicInteger<quint64> overruns_;
+    QAtomicInteger<qint64> maximum_;
+};
+
+#endif // LATENCYHISTOGRAM_H
@@ -23,6 +23,8 @@
 #include <QApplication>
 #include <QTranslator>
 #include <QLocale>
+#include <QFile>
+#include <QElapsedTimer>
 #ifdef __APPLE__
 #include "coremidi.h"
 #define HostMIDI CoreMIDI
@@ -34,9 +36,15 @@
 #define HostMIDI MIDI
 #endif
 #include "midiinterface.h"
+#include "miditracer.h"
 #include "player.h"
 #include "scheduler.h"
+#include "schedulercalibration.h"
+#include "song.h"
+#include "smf.h"
+#include "conversion.h"
 #include "mainwindow.h"
+#include <cstdlib>
 #include <signal.h>
 #include <dlfcn.h>
 
@@ -66,6 +74,33 @@ void restoreSignalHandlers()
     signal(SIGTERM, originalSigTermHandler);
 }
 
+void startTracing()
+{
+    if (getenv("TUTKA_MIDI_TRACE") != NULL) {
+        MIDITracer::enable();
+    }
+}
+
+void stopTracing()
+{
+    MIDITracer *tracer = MIDITracer::tracer();
+    if (tracer != NULL) {
+        const char *path = getenv("TUTKA_MIDI_TRACE");
+        if (!tracer->dump(path)) {
+            qWarning("Couldn't write MIDI trace to %s", path);
+        }
+        MIDITracer::disable();
+    }
+}
+
+void calibrateSchedulers()
+{
+    // Measure the schedulers on the first run only
+    if (!SchedulerCalibration::restore()) {
+        SchedulerCalibration::run();
+    }
+}
+
 int runWithGUI(int argc, char **argv)
 {
     QApplication app(argc, argv);
@@ -73,6 +108,8 @@ int runWithGUI(int argc, char **argv)
     (void)translator.load(QString("/usr/share/tutka/translations/tutka_") + QLocale::system().name());
     app.installTranslator(&translator);
 
+    startTracing();
+    calibrateSchedulers();
     MIDI *midi = new HostMIDI;
     Player *player = new Player(midi, argc > 1 ? argv[1] : QString());
     MainWindow *mainWindow = new MainWindow(player);
@@ -84,6 +121,7 @@ int runWithGUI(int argc, char **argv)
     delete mainWindow;
     delete player;
     delete midi;
+    stopTracing();
 
     return returnCode;
 }
@@ -99,9 +137,12 @@ int runWithoutGUI(int argc, char **argv)
     installSignalHandlers();
 
     QCoreApplication app(argc, argv);
+    startTracing();
+    calibrateSchedulers();
+    Scheduler *scheduler = SchedulerCalibration::best();
     MIDI *midi = new HostMIDI;
     Player *player = new Player(midi, argv[1]);
-    player->setScheduler(Scheduler::schedulers().last());
+    player->setScheduler(scheduler);
     player->setKillWhenLooped(true);
     QObject::connect(player, SIGNAL(finished()), &app, SLOT(quit()));
     for (int output = 0; output < midi->outputs(); output++) {
@@ -117,17 +158,78 @@ int runWithoutGUI(int argc, char **argv)
 
     int returnCode = app.exec();
 
+    // Report how accurately the ticks were played
+    qInfo("%s scheduler wake-up lateness: %s", scheduler->name(), qPrintable(scheduler->lateness().summary()));
+    qInfo("%s scheduler tick processing time: %s", scheduler->name(), qPrintable(scheduler->processing().summary()));
+
     delete player;
     delete midi;
+    stopTracing();
 
     restoreSignalHandlers();
 
     return returnCode;
 }
 
+int runRender(int argc, char **argv)
+{
+    Player::ExportOutputs exportOutputs = Player::ExportOutputsSingle;
+    if (argc > 4) {
+        if (strcmp(argv[4], "--split-tracks") == 0) {
+            exportOutputs = Player::ExportOutputsPerTrack;
+        } else if (strcmp(argv[4], "--split-instruments") == 0) {
+            exportOutputs = Player::ExportOutputsPerInstrument;
+        } else {
+            qWarning("Usage: %s --render in.tutka out.mid [--split-tracks|--split-instruments]", argv[0]);
+            return 1;
+        }
+    }
+
+    QCoreApplication app(argc, argv);
+    if (!QFile::exists(argv[2])) {
+        qWarning("%s: No such file", argv[2]);
+        return 1;
+    }
+
+    Song *song = loadSong(argv[2]);
+    QElapsedTimer timer;
+    timer.start();
+    unsigned int ticks = 0;
+    SMF *smf = songToSMF(song, exportOutputs, &ticks);
+    qint64 elapsed = timer.nsecsElapsed();
+    bool saved = smf->save(argv[3]);
+    delete smf;
+    delete song;
+
+    if (!saved) {
+        qWarning("Couldn't write %s", argv[3]);
+        return 1;
+    }
+
+    qInfo("Rendered %u ticks in %.3f ms (%.0f ticks/s)", ticks, elapsed / 1000000.0, elapsed > 0 ? ticks * 1000000000.0 / elapsed : 0.0);
+
+    return 0;
+}
+
+int runCalibration(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+
+    foreach (const SchedulerCalibration::Result &result, SchedulerCalibration::run(1000)) {
+        qInfo("%s scheduler: p99 lateness %.1f us, maximum lateness %.1f us, CPU load %.0f %%", qPrintable(result.scheduler), result.lateness / 1000.0, result.maximumLateness / 1000.0, result.cpuLoad * 100);
+    }
+    qInfo("Best scheduler: %s", SchedulerCalibration::best()->name());
+
+    return 0;
+}
+
 int main(int argc, char **argv)
 {
-    if (argc > 2 && strcmp(argv[1], "-p") == 0) {
+    if (argc > 1 && strcmp(argv[1], "--calibrate") == 0) {
+        return runCalibration(argc, argv);
+    } else if (argc > 3 && strcmp(argv[1], "--render") == 0) {
+        return runRender(argc, argv);
+    } else if (argc > 2 && strcmp(argv[1], "-p") == 0) {
         return runWithoutGUI(argc, argv);
     } else {
         return runWithGUI(argc, argv);
@@ -35,6 +35,7 @@
 #include <QActionGroup>
 #include <QAction>
 #include <QRegularExpression>
+#include <QBitArray>
 #include "instrumentpropertiesdialog.h"
 #include "preferencesdialog.h"
 #include "trackvolumesdialog.h"
@@ -56,9 +57,13 @@
 #include "smf.h"
 #include "midi.h"
 #include "midiinterface.h"
+#include "recorder.h"
 #include "ui_mainwindow.h"
 #include "mainwindow.h"
 
+// Values recorded from the MIDI input: the controllers and the pitch wheel
+#define VALUE_CHANGES 129
+
 MainWindow::MainWindow(Player *player, QWidget *parent) :
     QMainWindow(parent),
     player(player),
@@ -79,6 +84,7 @@ MainWindow::MainWindow(Player *player, QWidget *parent) :
     messageListDialog(new MessageListDialog(player->midi())),
     helpDialog(new HelpDialog),
     externalSyncActionGroup(new QActionGroup(this)),
+    recorder(new Recorder(player, this)),
     song(NULL),
     copySelection_(NULL),
     copyBlock_(NULL),
@@ -100,7 +106,7 @@ MainWindow::MainWindow(Player *player, QWidget *parent) :
     externalSyncActionGroup->addAction(ui->actionExternalSyncMidi);
     externalSyncActionGroup->setExclusive(true);
 
-    connect(player->midi(), SIGNAL(inputReceived(QByteArray)), this, SLOT(handleMidiInput(QByteArray)));
+    connect(player->midi(), SIGNAL(inputEventsReceived(QVector<MIDIInputEvent>)), this, SLOT(handleMidiInput(QVector<MIDIInputEvent>)));
     connect(player, SIGNAL(songChanged(Song *)), this, SLOT(setSong(Song *)));
     connect(player, SIGNAL(songChanged(Song *)), ui->tracker, SLOT(setSong(Song *)));
     connect(player, SIGNAL(songChanged(Song *)), transposeDialog, SLOT(setSong(Song *)));
@@ -156,6 +162,11 @@ MainWindow::MainWindow(Player *player, QWidget *parent) :
     connect(ui->comboBoxKeyboardOctaves, SIGNAL(currentIndexChanged(int)), ui->tracker, SLOT(setOctave(int)));
     connect(ui->checkBoxEdit, SIGNAL(toggled(bool)), ui->tracker, SLOT(setEditMode(bool)));
     connect(ui->checkBoxChord, SIGNAL(toggled(bool)), ui->tracker, SLOT(setChordMode(bool)));
+    connect(ui->actionSettingsRecordControllers, SIGNAL(toggled(bool)), recorder, SLOT(setRecordControllers(bool)));
+    connect(ui->actionSettingsQuantizeRecording, SIGNAL(toggled(bool)), recorder, SLOT(setQuantize(bool)));
+    connect(player, SIGNAL(modeChanged(Player::Mode)), recorder, SLOT(reset()));
+    connect(ui->actionSettingsMidiThru, SIGNAL(toggled(bool)), this, SLOT(updateThru()));
+    connect(player->midi(), SIGNAL(outputsChanged()), this, SLOT(updateThru()));
     connect(ui->actionFileNew, SIGNAL(triggered()), this, SLOT(newSong()));
     connect(ui->actionFileOpen, SIGNAL(triggered()), openDialog, SLOT(show()));
     connect(openDialog, SIGNAL(fileSelected(QString)), player, SLOT(setSong(QString)));
@@ -708,6 +719,8 @@ void MainWindow::setInstrument(int instrument)
         if (oldInstrument != NULL) {
             disconnect(oldInstrument, SIGNAL(nameChanged(QString)), ui->lineEditInstrument, SLOT(setText(QString)));
             disconnect(ui->lineEditInstrument, SIGNAL(textChanged(QString)), oldInstrument, SLOT(setName(QString)));
+            disconnect(oldInstrument, SIGNAL(routingChanged()), this, SLOT(updateThru()));
+            disconnect(oldInstrument, SIGNAL(transposeChanged(int)), this, SLOT(updateThru()));
         }
 
         this->instrument = instrument - 1;
@@ -716,11 +729,14 @@ void MainWindow::setInstrument(int instrument)
         Instrument *newInstrument = song->instrument(this->instrument);
         connect(newInstrument, SIGNAL(nameChanged(QString)), ui->lineEditInstrument, SLOT(setText(QString)));
         connect(ui->lineEditInstrument, SIGNAL(textChanged(QString)), newInstrument, SLOT(setName(QString)));
+        connect(newInstrument, SIGNAL(routingChanged()), this, SLOT(updateThru()));
+        connect(newInstrument, SIGNAL(transposeChanged(int)), this, SLOT(updateThru()));
 
         ui->lineEditInstrument->blockSignals(true);
         ui->lineEditInstrument->setText(newInstrument->name());
         ui->lineEditInstrument->blockSignals(false);
         ui->tracker->setInstrument(instrument);
+        updateThru();
     }
 }
 
@@ -861,6 +877,19 @@ void MainWindow::setExternalSync()
     player->setExternalSync(externalSyncActionGroup->checkedAction() == ui->actionExternalSyncOff ? Player::Off : Player::Midi);
 }
 
+void MainWindow::updateThru()
+{
+    // The input is played through the output and channel of the current instrument
+    MIDI *midi = player->midi();
+    Instrument *instrument = song != NULL ? song->instrument(this->instrument) : NULL;
+    if (ui->actionSettingsMidiThru->isChecked() && instrument != NULL && midi->outputs() > 0) {
+        unsigned int output = instrument->midiInterface() < midi->outputs() ? instrument->midiInterface() : 0;
+        midi->thru()->setRoute(midi->output(output), instrument->midiChannel(), instrument->transpose());
+    } else {
+        midi->thru()->setRoute(QSharedPointer<MIDIInterface>(), 0, 0);
+    }
+}
+
 void MainWindow::save()
 {
     QString path = song->path();
@@ -921,12 +950,39 @@ void MainWindow::setCommandPage()
     setCommandPage(ui->tracker->commandPage());
 }
 
-void MainWindow::handleMidiInput(const QByteArray &data)
+void MainWindow::handleMidiInput(const QVector<MIDIInputEvent> &events)
 {
-    if (data.length() == 0) {
+    // While playing the input is recorded where it was played instead of the cursor
+    if (ui->checkBoxEdit->isChecked() && ui->actionSettingsRecordWhilePlaying->isChecked() && player->mode() != Player::ModeIdle) {
+        recorder->record(events, song, ui->tracker->cursorTrack(), ui->spinBoxInstrument->value(), ui->tracker->commandPage());
         return;
     }
 
+    // A controller or pitch wheel change is overwritten by a later change of the same value unless a note moves the cursor in between
+    QVector<bool> overwritten(events.count());
+    QBitArray changed(VALUE_CHANGES);
+    for (int event = events.count() - 1; event >= 0; event--) {
+        const MIDIMessage &message = events.at(event).message;
+        int status = message.isEmpty() ? 0 : message.data()[0] & 0xf0;
+        int value = status == 0xb0 ? message.data()[1] & 0x7f : status == 0xe0 ? VALUE_CHANGES - 1 : -1;
+        if (status == 0x80 || status == 0x90) {
+            changed.fill(false);
+        } else if (value >= 0) {
+            overwritten[event] = changed.testBit(value);
+            changed.setBit(value);
+        }
+    }
+
+    for (int event = 0; event < events.count(); event++) {
+        const MIDIMessage &message = events.at(event).message;
+        if (!overwritten.at(event) && message.length() == MIDIMessage::MAXIMUM_LENGTH) {
+            handleMidiMessage(message.data());
+        }
+    }
+}
+
+void MainWindow::handleMidiMessage(const unsigned char *data)
+{
     Block *block = ui->tracker->block();
     switch (data[0] & 0xf0) {
     case 0x80:
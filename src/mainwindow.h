@@ -24,6 +24,7 @@
 #define MAINWINDOW_H_
 
 #include "player.h"
+#include "midiinputqueue.h"
 #include <QMainWindow>
 #include <QSettings>
 #include <QAction>
@@ -50,6 +51,7 @@ class HelpDialog;
 class QActionGroup;
 class Song;
 class Block;
+class Recorder;
 
 class MainWindow : public QMainWindow
 {
@@ -98,6 +100,7 @@ private slots:
     void deleteTrackCurrentBlock();
     void deleteTrackAllBlocks();
     void setExternalSync();
+    void updateThru();
     void save();
     void saveAs();
     void setSection();
@@ -105,7 +108,7 @@ private slots:
     void setPosition();
     void setBlock();
     void setCommandPage();
-    void handleMidiInput(const QByteArray &data);
+    void handleMidiInput(const QVector<MIDIInputEvent> &events);
     void setTrackerHorizontalScrollBar(int track, int tracks, int visibleTracks);
     void setTrackerVerticalScrollBar(int line, int length, int visibleLines);
     void setSongPath(const QString &path);
@@ -120,6 +123,8 @@ private:
     int showModifiedDialog() const;
     bool keyPress(QKeyEvent *event);
     bool keyRelease(QKeyEvent *event);
+    // Handles a three byte message received from the MIDI input
+    void handleMidiMessage(const unsigned char *data);
     static void setGeometryFromString(QWidget *widget, const QString &string);
     static QRect stringToRect(const QString &string);
     static QString rectToString(const QRect &rect);
@@ -143,6 +148,7 @@ private:
     MessageListDialog *messageListDialog;
     HelpDialog *helpDialog;
     QActionGroup *externalSyncActionGroup;
+    Recorder *recorder;
     Song *song;
     Block *copySelection_;
     Block *copyBlock_;
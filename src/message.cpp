@@ -61,6 +61,7 @@ void Message::setLength(unsigned int length)
         }
 
         emit lengthChanged();
+        emit dataChanged();
     }
 }
 
@@ -88,6 +89,7 @@ void Message::setData(const QByteArray &data)
     if (data_.length() != oldLength) {
         emit lengthChanged();
     }
+    emit dataChanged();
 }
 
 void Message::loadBinary(const QString &filename)
@@ -96,6 +98,8 @@ void Message::loadBinary(const QString &filename)
     if (file.open(QIODevice::ReadOnly)) {
         data_.resize(file.size());
         file.read(data_.data(), file.size());
+
+        emit dataChanged();
     }
 }
 
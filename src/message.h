@@ -75,6 +75,9 @@ signals:
     // Emitted when the length of the message changes
     void lengthChanged();
 
+    // Emitted when the contents of the message change
+    void dataChanged();
+
 private:
     // Name
     QString name_;
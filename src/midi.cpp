@@ -20,11 +20,17 @@
  * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  */
 
+#include <QMetaMethod>
 #include "midiinterface.h"
 #include "midi.h"
 
 MIDI::MIDI(QObject *parent) :
-    QObject(parent)
+    QObject(parent),
+    lookahead_(0),
+    inputLatency_(0),
+    inputDeliveryPending(0),
+    clockEnabled_(0),
+    thruOutput(NULL)
 {
     updateInterfaces();
 }
@@ -105,3 +111,145 @@ void MIDI::cont() const
         outputs_[output]->cont();
     }
 }
+
+bool MIDI::canSchedule() const
+{
+    return false;
+}
+
+unsigned int MIDI::lookahead() const
+{
+    return lookahead_;
+}
+
+void MIDI::setLookahead(unsigned int lookahead)
+{
+    lookahead_ = lookahead;
+}
+
+unsigned int MIDI::inputLatency() const
+{
+    return inputLatency_;
+}
+
+void MIDI::setInputLatency(unsigned int inputLatency)
+{
+    inputLatency_ = inputLatency;
+}
+
+void MIDI::startSchedule()
+{
+}
+
+void MIDI::discardSchedule()
+{
+}
+
+QList<int> MIDI::inputDescriptors() const
+{
+    return QList<int>();
+}
+
+void MIDI::acquireInput()
+{
+}
+
+void MIDI::releaseInput()
+{
+}
+
+unsigned int MIDI::readInput()
+{
+    return 0;
+}
+
+bool MIDI::clockEnabled() const
+{
+    return clockEnabled_.loadRelaxed() != 0;
+}
+
+void MIDI::setClockEnabled(bool enabled)
+{
+    clockEnabled_.storeRelaxed(enabled ? 1 : 0);
+}
+
+unsigned int MIDI::inputDropped() const
+{
+    return inputQueue.dropped();
+}
+
+MIDIThru *MIDI::thru()
+{
+    return &thru_;
+}
+
+void MIDI::queueInput(const unsigned char *data, int length, qint64 time)
+{
+    if (length <= 0) {
+        return;
+    }
+
+    if (length <= MIDIMessage::MAXIMUM_LENGTH) {
+        inputQueue.push(MIDIMessage(length, data[0], length > 1 ? data[1] : 0, length > 2 ? data[2] : 0), time);
+    } else {
+        inputQueue.push(QByteArray((const char *)data, length), time);
+    }
+}
+
+void MIDI::receiveInput(const unsigned char *data, int length, qint64 time)
+{
+    if (length > 0 && length <= MIDIMessage::MAXIMUM_LENGTH) {
+        MIDIInterface *output = thru_.route(MIDIMessage(length, data[0], length > 1 ? data[1] : 0, length > 2 ? data[2] : 0));
+        if (output != NULL) {
+            thruOutput = output;
+        }
+    }
+
+    queueInput(data, length, time);
+}
+
+void MIDI::commitInput()
+{
+    // Forwarded messages go out before the input is handled in the main thread
+    if (thruOutput != NULL) {
+        flushThru(thruOutput);
+        thruOutput = NULL;
+    }
+
+    inputQueue.commit();
+
+    // One queued call delivers everything received until it runs
+    if (inputDeliveryPending.testAndSetOrdered(0, 1)) {
+        QMetaObject::invokeMethod(this, "deliverInput", Qt::QueuedConnection);
+    }
+}
+
+void MIDI::flushThru(MIDIInterface *output)
+{
+    output->flushQueue();
+}
+
+void MIDI::deliverInput()
+{
+    // Input committed from now on needs another delivery
+    inputDeliveryPending.storeRelease(0);
+
+    inputBatch.clear();
+    MIDIInputEvent event;
+    while (inputQueue.pop(event)) {
+        inputBatch.append(event);
+    }
+
+    if (inputBatch.isEmpty()) {
+        return;
+    }
+
+    emit inputEventsReceived(inputBatch);
+
+    if (isSignalConnected(QMetaMethod::fromSignal(&MIDI::inputReceived))) {
+        for (int event = 0; event < inputBatch.count(); event++) {
+            const MIDIInputEvent &input = inputBatch.at(event);
+            emit inputReceived(input.message.isEmpty() ? input.data : QByteArray((const char *)input.message.data(), input.message.length()));
+        }
+    }
+}
@@ -26,6 +26,10 @@
 #include <QObject>
 #include <QSharedPointer>
 #include <QList>
+#include <QVector>
+#include <QAtomicInt>
+#include "midiinputqueue.h"
+#include "midithru.h"
 
 class MIDIInterface;
 class Message;
@@ -51,6 +55,52 @@ public:
     void stop() const;
     void cont() const;
 
+    // Returns whether the backend can deliver messages at the times set with MIDIInterface::setTime()
+    virtual bool canSchedule() const;
+
+    // Returns how many milliseconds ahead of delivery the player renders messages; 0 to send them immediately
+    unsigned int lookahead() const;
+
+    // Sets how many milliseconds ahead of delivery the player renders messages
+    void setLookahead(unsigned int lookahead);
+
+    // Returns how many milliseconds input arrives after it was played; recorded input is moved back by this much
+    unsigned int inputLatency() const;
+
+    // Sets how many milliseconds input arrives after it was played
+    void setInputLatency(unsigned int inputLatency);
+
+    // Starts a new schedule; the delivery times of messages are relative to this moment
+    virtual void startSchedule();
+
+    // Drops the scheduled messages that haven't been delivered yet except note offs
+    virtual void discardSchedule();
+
+    // Returns the file descriptors that become readable when input arrives; empty if the input can't be polled
+    virtual QList<int> inputDescriptors() const;
+
+    // Stops reading the input in the background so that the caller can read it with readInput()
+    virtual void acquireInput();
+
+    // Lets the input be read in the background again
+    virtual void releaseInput();
+
+    // Handles the input waiting to be read without blocking; clock messages are not signaled but
+    // their number is returned instead
+    virtual unsigned int readInput();
+
+    // Returns whether clock messages are received; they are dropped as soon as they are read otherwise
+    bool clockEnabled() const;
+
+    // Sets whether clock messages are received
+    void setClockEnabled(bool enabled);
+
+    // Returns the number of input messages dropped because they were not handled fast enough
+    unsigned int inputDropped() const;
+
+    // Returns the route forwarding input directly to an output
+    MIDIThru *thru();
+
 signals:
     void outputsChanged();
     void inputsChanged();
@@ -59,16 +109,53 @@ signals:
     void startReceived();
     void stopReceived();
     void continueReceived();
-    void clockReceived();
+    // Emitted when a clock message has been received at the given CLOCK_MONOTONIC time in nanoseconds
+    void clockReceived(qint64 time);
+    // Emitted when a song position pointer has been received; the position is in sixteenth notes
+    void songPositionReceived(unsigned int position);
+
+    // Emitted with all the input received since the previous batch
+    void inputEventsReceived(const QVector<MIDIInputEvent> &events);
 
-    // Emitted when input has been received
+    // Emitted for each message received; only emitted if connected since it allocates each message
     void inputReceived(QByteArray data);
 
 protected:
     virtual void updateInterfaces();
 
+    // Queues a received message for delivery in the main thread; may be called from the thread reading the input
+    void queueInput(const unsigned char *data, int length, qint64 time);
+
+    // Delivers the messages queued so far; may be called from the thread reading the input
+    void commitInput();
+
+    // Forwards a received message through the thru route and queues it for delivery; may be called from the thread reading the input
+    void receiveInput(const unsigned char *data, int length, qint64 time);
+
+    // Sends the messages forwarded to an output by the thru route without waiting for the output to be flushed otherwise
+    virtual void flushThru(MIDIInterface *output);
+
     QList<QSharedPointer<MIDIInterface> > outputs_;
     QList<QSharedPointer<MIDIInterface> > inputs_;
+
+private slots:
+    // Emits the queued input in the main thread
+    void deliverInput();
+
+private:
+    unsigned int lookahead_;
+    unsigned int inputLatency_;
+    // Received messages waiting to be delivered
+    MIDIInputQueue inputQueue;
+    // Whether delivering the queued input has been requested already
+    QAtomicInt inputDeliveryPending;
+    // Batch of delivered messages; kept to reuse the memory
+    QVector<MIDIInputEvent> inputBatch;
+    QAtomicInt clockEnabled_;
+    // Routes input directly to an output
+    MIDIThru thru_;
+    // Output the thru route wrote to since the input was last committed; only used by the thread reading the input
+    MIDIInterface *thruOutput;
 };
 
 #endif // _MIDI_H
@@ -0,0 +1,99 @@
+/*
+ * midiinputqueue.cpp
+ *
+ * Copyright 2002-2019 Vesa Halttunen
+ *
+ * This file is part of Tutka.
+ *
+ * Tutka is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tutka is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tutka; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "midiinputqueue.h"
+
+MIDIInputQueue::MIDIInputQueue() :
+    pendingHead(0),
+    head(0),
+    tail(0),
+    dropped_(0)
+{
+}
+
+bool MIDIInputQueue::push(const MIDIMessage &message, qint64 time)
+{
+    if (pendingHead - tail.loadAcquire() >= CAPACITY) {
+        dropped_.fetchAndAddRelaxed(1);
+        return false;
+    }
+
+    events[pendingHead & (CAPACITY - 1)] = message;
+    times[pendingHead & (CAPACITY - 1)] = time;
+    pendingHead++;
+
+    return true;
+}
+
+bool MIDIInputQueue::push(const QByteArray &data, qint64 time)
+{
+    if (pendingHead - tail.loadAcquire() >= CAPACITY) {
+        dropped_.fetchAndAddRelaxed(1);
+        return false;
+    }
+
+    // Long messages are rare; an empty message marks their place in the queue
+    longMessagesMutex.lock();
+    longMessages.append(data);
+    longMessagesMutex.unlock();
+
+    events[pendingHead & (CAPACITY - 1)] = MIDIMessage();
+    times[pendingHead & (CAPACITY - 1)] = time;
+    pendingHead++;
+
+    return true;
+}
+
+void MIDIInputQueue::commit()
+{
+    // Publish the pushed events to the consumer
+    head.storeRelease(pendingHead);
+}
+
+bool MIDIInputQueue::pop(MIDIInputEvent &event)
+{
+    unsigned int tail = this->tail.loadRelaxed();
+
+    if (tail == head.loadAcquire()) {
+        return false;
+    }
+
+    event.message = events[tail & (CAPACITY - 1)];
+    event.time = times[tail & (CAPACITY - 1)];
+    if (event.message.isEmpty()) {
+        longMessagesMutex.lock();
+        event.data = longMessages.takeFirst();
+        longMessagesMutex.unlock();
+    } else {
+        event.data.clear();
+    }
+
+    // Give the slot back to the producer
+    this->tail.storeRelease(tail + 1);
+
+    return true;
+}
+
+unsigned int MIDIInputQueue::dropped() const
+{
+    return dropped_.loadRelaxed();
+}
@@ -0,0 +1,89 @@
+/*
+ * midiinputqueue.h
+ *
+ * Copyright 2002-2019 Vesa Halttunen
+ *
+ * This file is part of Tutka.
+ *
+ * Tutka is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tutka is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tutka; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef MIDIINPUTQUEUE_H
+#define MIDIINPUTQUEUE_H
+
+#include <QAtomicInteger>
+#include <QByteArray>
+#include <QList>
+#include <QMutex>
+#include "midimessage.h"
+
+// A received MIDI message and the CLOCK_MONOTONIC time it arrived at
+class MIDIInputEvent {
+public:
+    // The message if at most three bytes long
+    MIDIMessage message;
+    // The message if longer than three bytes (SysEx); empty otherwise
+    QByteArray data;
+    // Arrival time in nanoseconds
+    qint64 time;
+};
+
+// A fixed size single producer, single consumer queue of incoming MIDI
+// messages. The thread reading the MIDI input pushes the messages it
+// receives without allocating memory or blocking and the main thread
+// takes them out in batches.
+class MIDIInputQueue {
+public:
+    // Number of messages the queue can hold; must be a power of two
+    enum {
+        CAPACITY = 4096
+    };
+
+    MIDIInputQueue();
+
+    // Queues a message received at the given time; returns false and counts a drop if the queue is full
+    bool push(const MIDIMessage &message, qint64 time);
+
+    // Queues a message longer than three bytes; returns false and counts a drop if the queue is full
+    bool push(const QByteArray &data, qint64 time);
+
+    // Makes the messages pushed so far available to the consumer
+    void commit();
+
+    // Takes the oldest message from the queue; returns false if the queue is empty
+    bool pop(MIDIInputEvent &event);
+
+    // Returns the number of messages dropped because the queue was full
+    unsigned int dropped() const;
+
+private:
+    // Queued messages; an empty message marks the place of a message in the long message list
+    MIDIMessage events[CAPACITY];
+    // Arrival times of the queued messages
+    qint64 times[CAPACITY];
+    // Index of the next message to be pushed; only used by the producer
+    unsigned int pendingHead;
+    // Index after the last committed message; only written by the producer
+    QAtomicInteger<unsigned int> head;
+    // Index of the next message to be popped; only written by the consumer
+    QAtomicInteger<unsigned int> tail;
+    // Statistics
+    QAtomicInteger<unsigned int> dropped_;
+    // Messages longer than three bytes (SysEx) in the order they were queued
+    QList<QByteArray> longMessages;
+    QMutex longMessagesMutex;
+};
+
+#endif // MIDIINPUTQUEUE_H
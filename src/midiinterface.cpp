@@ -20,20 +20,46 @@
  * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  */
 
+#include <QAtomicInteger>
 #include <QByteArray>
+#include <QSemaphore>
+#include <QThread>
+#include "midioutputqueue.h"
+#include "miditracer.h"
 #include "midiinterface.h"
 
+// Logging of every message; enabled by adding MIDI_DEBUG_OUTPUT to DEFINES and removing QT_NO_DEBUG_OUTPUT
+#ifdef MIDI_DEBUG_OUTPUT
+#define MIDI_DEBUG(...) qDebug(__VA_ARGS__)
+#else
+#define MIDI_DEBUG(...) do { if (false) qDebug(__VA_ARGS__); } while (0)
+#endif
+
+// Serial number for the next interface
+static QAtomicInteger<unsigned short> nextSerial;
+
 MIDIInterface::MIDIInterface(DirectionFlags flags, QObject *parent) :
     QObject(parent),
     name_(tr("No output")),
     flags_(flags),
     enabled(false),
-    tick(0)
+    tick(0),
+    batching(0),
+    writeTime(-1),
+    serial_(nextSerial.fetchAndAddRelaxed(1)),
+    time(-1),
+    queue(NULL),
+    sharedQueue(NULL),
+    queueOwner(NULL),
+    queueSequence(0),
+    queueWakeup(NULL)
 {
 }
 
 MIDIInterface::~MIDIInterface()
 {
+    delete queue;
+    delete sharedQueue;
 }
 
 QString MIDIInterface::name() const
@@ -46,6 +72,11 @@ MIDIInterface::DirectionFlags MIDIInterface::flags() const
     return flags_;
 }
 
+unsigned short MIDIInterface::serial() const
+{
+    return serial_;
+}
+
 bool MIDIInterface::isEnabled() const
 {
     return enabled;
@@ -65,146 +96,292 @@ void MIDIInterface::setTick(unsigned int tick)
     this->tick = tick;
 }
 
-void MIDIInterface::noteOff(unsigned char channel, unsigned char note, unsigned char velocity)
+void MIDIInterface::beginTick(unsigned int tick)
 {
-    qDebug("Note off %d %d %d", channel, note, velocity);
+    setTick(tick);
 
-    QByteArray data(3, 0);
+    // The batch is collected in the unlocked queue unless another thread is collecting one in it already;
+    // the queue is given back in flush() so it never has more than one producer
+    queueOwner.testAndSetOrdered(NULL, QThread::currentThreadId());
+    batching.storeRelaxed(1);
+}
 
-    data[0] = 0x80 | channel;
-    data[1] = note & 0x7f;
-    data[2] = velocity & 0x7f;
+void MIDIInterface::flush()
+{
+    batching.storeRelaxed(0);
+
+    if (queue != NULL) {
+        if (queueOwner.loadAcquire() == QThread::currentThreadId()) {
+            queue->commit();
+            if (queueWakeup != NULL) {
+                queueWakeup->release();
+            }
+            queueOwner.storeRelease(NULL);
+        }
+    } else {
+        drain();
+    }
+}
 
-    writeRaw(data);
+void MIDIInterface::setTime(qint64 time)
+{
+    this->time = time;
 }
 
-void MIDIInterface::noteOn(unsigned char channel, unsigned char note, unsigned char velocity)
+void MIDIInterface::noteOff(unsigned char channel, unsigned char note, unsigned char velocity)
 {
-    qDebug("Note on %d %d %d", channel, note, velocity);
+    MIDI_DEBUG("Note off %d %d %d", channel, note, velocity);
 
-    QByteArray data(3, 0);
+    writeRaw(MIDIMessage(3, 0x80 | channel, note & 0x7f, velocity & 0x7f));
+}
 
-    data[0] = 0x90 | channel;
-    data[1] = note & 0x7f;
-    data[2] = velocity & 0x7f;
+void MIDIInterface::noteOn(unsigned char channel, unsigned char note, unsigned char velocity)
+{
+    MIDI_DEBUG("Note on %d %d %d", channel, note, velocity);
 
-    writeRaw(data);
+    writeRaw(MIDIMessage(3, 0x90 | channel, note & 0x7f, velocity & 0x7f));
 }
 
 void MIDIInterface::aftertouch(unsigned char channel, unsigned char note, unsigned char pressure)
 {
-    qDebug("Aftertouch %d %d %d", channel, note, pressure);
-
-    QByteArray data(3, 0);
-
-    data[0] = 0xa0 | channel;
-    data[1] = note & 0x7f;
-    data[2] = pressure & 0x7f;
+    MIDI_DEBUG("Aftertouch %d %d %d", channel, note, pressure);
 
-    writeRaw(data);
+    writeRaw(MIDIMessage(3, 0xa0 | channel, note & 0x7f, pressure & 0x7f));
 }
 
 void MIDIInterface::controller(unsigned char channel, unsigned char controller, unsigned char value)
 {
-    qDebug("Controller %d %d %d", channel, controller, value);
+    MIDI_DEBUG("Controller %d %d %d", channel, controller, value);
 
-    QByteArray data(3, 0);
-
-    data[0] = 0xb0 | channel;
-    data[1] = controller & 0x7f;
-    data[2] = value & 0x7f;
-
-    writeRaw(data);
+    writeRaw(MIDIMessage(3, 0xb0 | channel, controller & 0x7f, value & 0x7f));
 }
 
 void MIDIInterface::programChange(unsigned char channel, unsigned char program)
 {
-    qDebug("Program change %d %d", channel, program);
-
-    QByteArray data(2, 0);
+    MIDI_DEBUG("Program change %d %d", channel, program);
 
-    data[0] = 0xc0 | channel;
-    data[1] = program & 0x7f;
-
-    writeRaw(data);
+    writeRaw(MIDIMessage(2, 0xc0 | channel, program & 0x7f));
 }
 
 void MIDIInterface::channelPressure(unsigned char channel, unsigned char pressure)
 {
-    qDebug("Channel pressure %d %d", channel, pressure);
-
-    QByteArray data(2, 0);
+    MIDI_DEBUG("Channel pressure %d %d", channel, pressure);
 
-    data[0] = 0xd0 | channel;
-    data[1] = pressure & 0x7f;
-
-    writeRaw(data);
+    writeRaw(MIDIMessage(2, 0xd0 | channel, pressure & 0x7f));
 }
 
 void MIDIInterface::pitchWheel(unsigned char channel, unsigned short value)
 {
-    qDebug("Pitch wheel %d %d", channel, value);
-
-    QByteArray data(3, 0);
+    MIDI_DEBUG("Pitch wheel %d %d", channel, value);
 
-    data[0] = 0xe0 | channel;
-    data[1] = (value >> 7) & 0x7f;
-    data[2] = value & 0x7f;
+    writeRaw(MIDIMessage(3, 0xe0 | channel, (value >> 7) & 0x7f, value & 0x7f));
+}
 
-    writeRaw(data);
+void MIDIInterface::writeRaw(const MIDIMessage &message)
+{
+    MIDI_DEBUG("Write raw %d", message.length());
+
+    if (enabled && !message.isEmpty()) {
+        MIDITracer *tracer = MIDITracer::tracer();
+        if (tracer != NULL) {
+            tracer->record(serial_, tick, message.data(), message.length());
+        }
+
+        if (queue != NULL) {
+            MIDIOutputQueue *threadQueue = beginQueueing();
+            threadQueue->push(message, time, queueSequence.fetchAndAddRelaxed(1));
+            endQueueing(threadQueue);
+        } else {
+            writeTime = time;
+            write(message);
+            if (batching.loadRelaxed() == 0) {
+                drain();
+            }
+        }
+    }
 }
 
 void MIDIInterface::writeRaw(const QByteArray &data)
 {
-    qDebug("Write raw %p %lld", data.constData(), data.length());
+    MIDI_DEBUG("Write raw %p %lld", data.constData(), data.length());
+
+    if (data.length() <= MIDIMessage::MAXIMUM_LENGTH) {
+        // Short messages don't need to be passed around as byte arrays
+        writeRaw(MIDIMessage(data.length(), data.length() > 0 ? data[0] : 0, data.length() > 1 ? data[1] : 0, data.length() > 2 ? data[2] : 0));
+    } else if (enabled) {
+        MIDITracer *tracer = MIDITracer::tracer();
+        if (tracer != NULL) {
+            tracer->record(serial_, tick, (const unsigned char *)data.constData(), data.length());
+        }
+
+        if (queue != NULL) {
+            MIDIOutputQueue *threadQueue = beginQueueing();
+            threadQueue->push(data, time, queueSequence.fetchAndAddRelaxed(1));
+            endQueueing(threadQueue);
+        } else {
+            writeTime = time;
+            write(data);
+            if (batching.loadRelaxed() == 0) {
+                drain();
+            }
+        }
+    }
+}
 
-    if (enabled && !data.isEmpty()) {
-        write(data);
+void MIDIInterface::writeNow(const MIDIMessage &message)
+{
+    MIDI_DEBUG("Write now %d", message.length());
+
+    if (enabled && !message.isEmpty()) {
+        MIDITracer *tracer = MIDITracer::tracer();
+        if (tracer != NULL) {
+            tracer->record(serial_, tick, message.data(), message.length());
+        }
+
+        if (queue != NULL) {
+            // Committing makes the messages of the batch being written available early but they keep their delivery times
+            MIDIOutputQueue *threadQueue = beginQueueing();
+            threadQueue->push(message, -1, queueSequence.fetchAndAddRelaxed(1));
+            endQueueing(threadQueue, true);
+        } else {
+            queueMutex.lock();
+            writeTime = -1;
+            write(message);
+            drain();
+            queueMutex.unlock();
+        }
     }
 }
 
 void MIDIInterface::clock()
 {
-    qDebug("Clock");
+    MIDI_DEBUG("Clock");
 
-    QByteArray data(1, 0xf8);
-
-    writeRaw(data);
+    writeRaw(MIDIMessage(1, 0xf8));
 }
 
 void MIDIInterface::start()
 {
-    qDebug("Start");
-
-    QByteArray data(1, 0xfa);
+    MIDI_DEBUG("Start");
 
-    writeRaw(data);
+    writeRaw(MIDIMessage(1, 0xfa));
 }
 
 void MIDIInterface::cont()
 {
-    qDebug("Continue");
+    MIDI_DEBUG("Continue");
 
-    QByteArray data(1, 0xfb);
-
-    writeRaw(data);
+    writeRaw(MIDIMessage(1, 0xfb));
 }
 
 void MIDIInterface::stop()
 {
-    qDebug("Stop");
-
-    QByteArray data(1, 0xfc);
+    MIDI_DEBUG("Stop");
 
-    writeRaw(data);
+    writeRaw(MIDIMessage(1, 0xfc));
 }
 
 void MIDIInterface::tempo(unsigned int tempo)
 {
-    qDebug("Tempo %d", tempo);
+    MIDI_DEBUG("Tempo %d", tempo);
+}
+
+void MIDIInterface::write(const MIDIMessage &message)
+{
+    MIDI_DEBUG("Write %d bytes", message.length());
 }
 
 void MIDIInterface::write(const QByteArray &data)
 {
-    qDebug("Write %lld bytes", data.length());
+    MIDI_DEBUG("Write %lld bytes", data.length());
+}
+
+void MIDIInterface::drain()
+{
+}
+
+void MIDIInterface::enableQueue(QSemaphore *wakeup)
+{
+    if (queue == NULL) {
+        queue = new MIDIOutputQueue;
+        sharedQueue = new MIDIOutputQueue;
+        queueWakeup = wakeup;
+    }
+}
+
+MIDIOutputQueue *MIDIInterface::beginQueueing()
+{
+    // Only the thread collecting a batch can find itself as the owner
+    if (QThread::currentThreadId() == queueOwner.loadAcquire()) {
+        return queue;
+    }
+
+    queueMutex.lock();
+    return sharedQueue;
+}
+
+void MIDIInterface::endQueueing(MIDIOutputQueue *queue, bool now)
+{
+    // The unlocked queue is committed by flush() unless the message is needed now
+    bool shared = queue == sharedQueue;
+    if (now || shared) {
+        queue->commit();
+        if (queueWakeup != NULL) {
+            queueWakeup->release();
+        }
+    }
+
+    if (shared) {
+        queueMutex.unlock();
+    }
+}
+
+int MIDIInterface::flushQueue()
+{
+    int sent = 0;
+
+    if (queue != NULL) {
+        // Send the messages of both queues in the order they were written
+        MIDIMessage message;
+        QByteArray data;
+        unsigned int batchSequence, sharedSequence;
+        while (true) {
+            bool batched = queue->front(batchSequence);
+            bool shared = sharedQueue->front(sharedSequence);
+            if (!batched && !shared) {
+                break;
+            }
+
+            MIDIOutputQueue *next = batched && (!shared || (int)(batchSequence - sharedSequence) < 0) ? queue : sharedQueue;
+            next->pop(message, data, writeTime);
+            if (!message.isEmpty()) {
+                write(message);
+            } else {
+                write(data);
+            }
+            sent++;
+        }
+
+        // Send everything at once
+        if (sent > 0) {
+            drain();
+        }
+    }
+
+    return sent;
+}
+
+unsigned int MIDIInterface::queueDepth() const
+{
+    return queue != NULL ? queue->depth() + sharedQueue->depth() : 0;
+}
+
+unsigned int MIDIInterface::queueMaximumDepth() const
+{
+    return queue != NULL ? qMax(queue->maximumDepth(), sharedQueue->maximumDepth()) : 0;
+}
+
+unsigned int MIDIInterface::queueDropped() const
+{
+    return queue != NULL ? queue->dropped() + sharedQueue->dropped() : 0;
 }
@@ -25,8 +25,14 @@
 
 #include <QObject>
 #include <QString>
+#include <QMutex>
+#include <QAtomicInteger>
+#include <QAtomicPointer>
+#include "midimessage.h"
 
 class QByteArray;
+class QSemaphore;
+class MIDIOutputQueue;
 
 class MIDIInterface : public QObject
 {
@@ -48,12 +54,25 @@ public:
     // Returns the flags for the interface
     DirectionFlags flags() const;
 
+    // Returns a number identifying the interface in MIDI traces
+    unsigned short serial() const;
+
     // Whether the interface is enabled or not
     bool isEnabled() const;
 
     // Sets the current tick
     void setTick(unsigned int);
 
+    // Sets the current tick and collects the messages written until flush() into a batch
+    void beginTick(unsigned int);
+
+    // Sends the messages written since beginTick()
+    void flush();
+
+    // Sets the time the messages written from now on are to be delivered at, in nanoseconds
+    // from the start of the backend's schedule; negative to send them immediately
+    void setTime(qint64 time);
+
     // Stops a note playing on a MIDI channel using requested velocity
     void noteOff(unsigned char, unsigned char, unsigned char);
 
@@ -76,8 +95,14 @@ public:
     void pitchWheel(unsigned char, unsigned short);
 
     // Sends a MIDI message
+    void writeRaw(const MIDIMessage &message);
+
+    // Sends a MIDI message of any length
     void writeRaw(const QByteArray &data);
 
+    // Sends a MIDI message immediately regardless of the delivery time and batch of the player; safe to call from any thread
+    void writeNow(const MIDIMessage &message);
+
     // Send a clock message
     void clock();
 
@@ -93,9 +118,32 @@ public:
     // Set the tempo (used when exporting)
     virtual void tempo(unsigned int);
 
+    // Sends the messages waiting in the output queue; returns the number of messages sent
+    int flushQueue();
+
+    // Returns the number of messages waiting in the output queue
+    unsigned int queueDepth() const;
+
+    // Returns the highest number of messages that have been waiting in the output queue
+    unsigned int queueMaximumDepth() const;
+
+    // Returns the number of messages dropped because the output queue was full
+    unsigned int queueDropped() const;
+
 protected:
+    // Writes a message; the backend may hold on to it until drain() is called
+    virtual void write(const MIDIMessage &message);
+
+    // Writes a message of any length; the backend may hold on to it until drain() is called
     virtual void write(const QByteArray &data);
 
+    // Sends the messages held by write()
+    virtual void drain();
+
+    // Makes written messages go through output queues to be sent by flushQueue(); wakeup is released
+    // whenever queued messages become available so the thread sending them can sleep until then
+    void enableQueue(QSemaphore *wakeup = NULL);
+
 public slots:
     // Enables or disables the interface
     virtual void setEnabled(bool enabled);
@@ -112,6 +160,34 @@ protected:
     DirectionFlags flags_;
     bool enabled;
     unsigned int tick;
+    // Whether messages are being collected into a batch
+    QAtomicInt batching;
+    // Delivery time of the message being passed to write(); negative if it is to be sent immediately
+    qint64 writeTime;
+
+private:
+    // Returns the output queue of the calling thread, locking the shared queue if necessary
+    MIDIOutputQueue *beginQueueing();
+
+    // Makes the messages pushed since beginQueueing() available unless a batch is being collected
+    void endQueueing(MIDIOutputQueue *queue, bool now = false);
+
+    // Number identifying the interface in MIDI traces
+    unsigned short serial_;
+    // Delivery time of the messages being written
+    qint64 time;
+    // Output queue of the thread collecting a batch; it pushes without locking. NULL if messages are written directly
+    MIDIOutputQueue *queue;
+    // Output queue of the other threads
+    MIDIOutputQueue *sharedQueue;
+    // Serializes the threads writing to the shared queue
+    QMutex queueMutex;
+    // Thread collecting a batch in the unlocked queue; NULL when no batch is being collected
+    QAtomicPointer<void> queueOwner;
+    // Sequence number of the next message queued; orders the messages of the two queues
+    QAtomicInteger<unsigned int> queueSequence;
+    // Released when queued messages become available; may be NULL
+    QSemaphore *queueWakeup;
 };
 
 Q_DECLARE_OPERATORS_FOR_FLAGS(MIDIInterface::DirectionFlags)
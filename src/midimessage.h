@@ -0,0 +1,74 @@
+/*
+ * midimessage.h
+ *
+ * Copyright 2002-2019 Vesa Halttunen
+ *
+ * This file is part of Tutka.
+ *
+ * Tutka is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tutka is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tutka; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef MIDIMESSAGE_H
+#define MIDIMESSAGE_H
+
+// A MIDI message of at most three bytes stored inline, so creating and
+// copying one never allocates memory. Longer messages (SysEx) are passed
+// around as QByteArrays instead.
+class MIDIMessage {
+public:
+    // Maximum length of a message
+    enum {
+        MAXIMUM_LENGTH = 3
+    };
+
+    // Creates an empty message
+    MIDIMessage() :
+        length_(0)
+    {
+    }
+
+    // Creates a message with a status byte and up to two data bytes
+    MIDIMessage(int length, unsigned char status, unsigned char data1 = 0, unsigned char data2 = 0) :
+        length_(length)
+    {
+        data_[0] = status;
+        data_[1] = data1;
+        data_[2] = data2;
+    }
+
+    // Returns the length of the message in bytes
+    int length() const
+    {
+        return length_;
+    }
+
+    // Returns whether the message is empty
+    bool isEmpty() const
+    {
+        return length_ == 0;
+    }
+
+    // Returns the bytes of the message
+    const unsigned char *data() const
+    {
+        return data_;
+    }
+
+private:
+    unsigned char data_[MAXIMUM_LENGTH];
+    unsigned char length_;
+};
+
+#endif // MIDIMESSAGE_H
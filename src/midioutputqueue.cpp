@@ -0,0 +1,144 @@
+/*
+ * midioutputqueue.cpp
+ *
+ * Copyright 2002-2019 Vesa Halttunen
+ *
+ * This file is part of Tutka.
+ *
+ * Tutka is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tutka is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tutka; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "midioutputqueue.h"
+
+MIDIOutputQueue::MIDIOutputQueue() :
+    pendingHead(0),
+    head(0),
+    tail(0),
+    maximumDepth_(0),
+    dropped_(0)
+{
+}
+
+bool MIDIOutputQueue::push(const MIDIMessage &message, qint64 time, unsigned int sequence)
+{
+    if (pendingHead - tail.loadAcquire() >= (isRelease(message) ? CAPACITY : CAPACITY - RESERVED)) {
+        dropped_.fetchAndAddRelaxed(1);
+        return false;
+    }
+
+    events[pendingHead & (CAPACITY - 1)] = message;
+    times[pendingHead & (CAPACITY - 1)] = time;
+    sequences[pendingHead & (CAPACITY - 1)] = sequence;
+    pendingHead++;
+
+    return true;
+}
+
+bool MIDIOutputQueue::push(const QByteArray &data, qint64 time, unsigned int sequence)
+{
+    if (pendingHead - tail.loadAcquire() >= CAPACITY - RESERVED) {
+        dropped_.fetchAndAddRelaxed(1);
+        return false;
+    }
+
+    // Long messages are rare; an empty message marks their place in the queue
+    longMessagesMutex.lock();
+    longMessages.append(data);
+    longMessagesMutex.unlock();
+
+    events[pendingHead & (CAPACITY - 1)] = MIDIMessage();
+    times[pendingHead & (CAPACITY - 1)] = time;
+    sequences[pendingHead & (CAPACITY - 1)] = sequence;
+    pendingHead++;
+
+    return true;
+}
+
+void MIDIOutputQueue::commit()
+{
+    // Publish the pushed events to the consumer
+    head.storeRelease(pendingHead);
+
+    unsigned int depth = pendingHead - tail.loadAcquire();
+    if (depth > maximumDepth_.loadRelaxed()) {
+        maximumDepth_.storeRelaxed(depth);
+    }
+}
+
+bool MIDIOutputQueue::front(unsigned int &sequence) const
+{
+    unsigned int tail = this->tail.loadRelaxed();
+
+    if (tail == head.loadAcquire()) {
+        return false;
+    }
+
+    sequence = sequences[tail & (CAPACITY - 1)];
+    return true;
+}
+
+bool MIDIOutputQueue::pop(MIDIMessage &message, QByteArray &data, qint64 &time)
+{
+    unsigned int tail = this->tail.loadRelaxed();
+
+    if (tail == head.loadAcquire()) {
+        return false;
+    }
+
+    message = events[tail & (CAPACITY - 1)];
+    time = times[tail & (CAPACITY - 1)];
+    if (message.isEmpty()) {
+        longMessagesMutex.lock();
+        data = longMessages.takeFirst();
+        longMessagesMutex.unlock();
+    }
+
+    // Give the slot back to the producer
+    this->tail.storeRelease(tail + 1);
+
+    return true;
+}
+
+bool MIDIOutputQueue::isRelease(const MIDIMessage &message)
+{
+    const unsigned char *data = message.data();
+    switch (data[0] & 0xf0) {
+    case 0x80:
+        return true;
+    case 0x90:
+        // A note on with zero velocity is a note off
+        return message.length() > 2 && data[2] == 0;
+    case 0xb0:
+        // Channel mode messages: all sound off, reset all controllers, all notes off and so on
+        return message.length() > 1 && data[1] >= 120;
+    default:
+        return false;
+    }
+}
+
+unsigned int MIDIOutputQueue::depth() const
+{
+    return head.loadAcquire() - tail.loadAcquire();
+}
+
+unsigned int MIDIOutputQueue::maximumDepth() const
+{
+    return maximumDepth_.loadRelaxed();
+}
+
+unsigned int MIDIOutputQueue::dropped() const
+{
+    return dropped_.loadRelaxed();
+}
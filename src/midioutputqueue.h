@@ -0,0 +1,97 @@
+/*
+ * midioutputqueue.h
+ *
+ * Copyright 2002-2019 Vesa Halttunen
+ *
+ * This file is part of Tutka.
+ *
+ * Tutka is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tutka is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tutka; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef MIDIOUTPUTQUEUE_H
+#define MIDIOUTPUTQUEUE_H
+
+#include <QAtomicInteger>
+#include <QByteArray>
+#include <QList>
+#include <QMutex>
+#include "midimessage.h"
+
+// A fixed size single producer, single consumer queue of outgoing MIDI
+// messages. Pushing and popping short messages only touches preallocated
+// memory and atomics, so the player thread can queue messages without
+// blocking or making system calls while an output thread sends them.
+class MIDIOutputQueue {
+public:
+    // Number of messages the queue can hold; must be a power of two. The last RESERVED places
+    // are only used by messages that stop notes so a full queue doesn't leave notes hanging.
+    enum {
+        CAPACITY = 4096,
+        RESERVED = 256
+    };
+
+    MIDIOutputQueue();
+
+    // Queues a message to be delivered at the given time; returns false and counts a drop if the queue is full.
+    // The sequence number orders the message among those of other queues.
+    bool push(const MIDIMessage &message, qint64 time = -1, unsigned int sequence = 0);
+
+    // Queues a message longer than three bytes; returns false and counts a drop if the queue is full
+    bool push(const QByteArray &data, qint64 time = -1, unsigned int sequence = 0);
+
+    // Makes the messages pushed so far available to the consumer
+    void commit();
+
+    // Gets the sequence number of the oldest message in the queue; returns false if the queue is empty
+    bool front(unsigned int &sequence) const;
+
+    // Takes the oldest message from the queue; returns false if the queue is empty.
+    // If the message is longer than three bytes message is left empty and data is set instead.
+    bool pop(MIDIMessage &message, QByteArray &data, qint64 &time);
+
+    // Returns the number of messages currently in the queue
+    unsigned int depth() const;
+
+    // Returns the highest number of messages that have been in the queue at once
+    unsigned int maximumDepth() const;
+
+    // Returns the number of messages dropped because the queue was full
+    unsigned int dropped() const;
+
+private:
+    // Returns whether a message stops notes or resets controllers
+    static bool isRelease(const MIDIMessage &message);
+
+    // Queued messages; an empty message marks the place of a message in the long message list
+    MIDIMessage events[CAPACITY];
+    // Delivery times of the queued messages; negative if a message is to be sent immediately
+    qint64 times[CAPACITY];
+    // Sequence numbers of the queued messages
+    unsigned int sequences[CAPACITY];
+    // Index of the next message to be pushed; only used by the producer
+    unsigned int pendingHead;
+    // Index after the last committed message; only written by the producer
+    QAtomicInteger<unsigned int> head;
+    // Index of the next message to be popped; only written by the consumer
+    QAtomicInteger<unsigned int> tail;
+    // Statistics
+    QAtomicInteger<unsigned int> maximumDepth_;
+    QAtomicInteger<unsigned int> dropped_;
+    // Messages longer than three bytes (SysEx) in the order they were queued
+    QList<QByteArray> longMessages;
+    QMutex longMessagesMutex;
+};
+
+#endif // MIDIOUTPUTQUEUE_H
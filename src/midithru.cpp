@@ -0,0 +1,109 @@
+/*
+ * midithru.cpp
+ *
+ * Copyright 2002-2019 Vesa Halttunen
+ *
+ * This file is part of Tutka.
+ *
+ * Tutka is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tutka is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tutka; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "midiinterface.h"
+#include "midithru.h"
+
+MIDIThru::MIDIThru() :
+    channel(0),
+    transpose(0)
+{
+    for (int note = 0; note < 128; note++) {
+        notes[note] = -1;
+    }
+}
+
+MIDIThru::~MIDIThru()
+{
+    mutex.lock();
+    stopNotes();
+    mutex.unlock();
+}
+
+void MIDIThru::setRoute(const QSharedPointer<MIDIInterface> &output, unsigned char channel, int transpose)
+{
+    mutex.lock();
+    if (output != this->output || channel != this->channel || transpose != this->transpose) {
+        // Notes held would not be released on the new route
+        stopNotes();
+
+        this->output = output;
+        this->channel = channel & 0x0f;
+        this->transpose = transpose;
+    }
+    mutex.unlock();
+}
+
+MIDIInterface *MIDIThru::route(const MIDIMessage &message)
+{
+    const unsigned char *data = message.data();
+    if (message.isEmpty() || data[0] < 0x80 || data[0] >= 0xf0) {
+        return NULL;
+    }
+
+    mutex.lock();
+    MIDIInterface *output = this->output.data();
+    if (output != NULL) {
+        int status = data[0] & 0xf0;
+        unsigned char data1 = message.length() > 1 ? data[1] & 0x7f : 0;
+        bool forward = true;
+
+        if (status == 0x90 && message.length() > 2 && data[2] > 0) {
+            // Remember the transposed note so that it is released even if the transposition changes
+            int note = data1 + transpose;
+            forward = note >= 0 && note < 128;
+            notes[data1] = forward ? note : -1;
+            data1 = note;
+        } else if (status == 0x80 || status == 0x90 || status == 0xa0) {
+            forward = notes[data1] >= 0;
+            if (status != 0xa0) {
+                unsigned char note = notes[data1];
+                notes[data1] = -1;
+                data1 = note;
+            } else {
+                data1 = notes[data1];
+            }
+        }
+
+        if (forward) {
+            output->writeNow(MIDIMessage(message.length(), status | channel, data1, message.length() > 2 ? data[2] : 0));
+        } else {
+            output = NULL;
+        }
+    }
+    mutex.unlock();
+
+    return output;
+}
+
+void MIDIThru::stopNotes()
+{
+    for (int note = 0; note < 128; note++) {
+        if (notes[note] >= 0) {
+            // The output may not be flushed by anyone after this
+            if (!output.isNull()) {
+                output->writeNow(MIDIMessage(3, 0x80 | channel, notes[note], 0));
+            }
+            notes[note] = -1;
+        }
+    }
+}
@@ -0,0 +1,60 @@
+/*
+ * midithru.h
+ *
+ * Copyright 2002-2019 Vesa Halttunen
+ *
+ * This file is part of Tutka.
+ *
+ * Tutka is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tutka is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tutka; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef MIDITHRU_H
+#define MIDITHRU_H
+
+#include <QMutex>
+#include <QSharedPointer>
+#include "midimessage.h"
+
+class MIDIInterface;
+
+// Forwards channel messages from the MIDI input to an output on another
+// channel and transposed, like the current instrument would play them.
+// Routing is done in the thread reading the input so that the messages
+// don't wait for the main thread's event loop.
+class MIDIThru {
+public:
+    MIDIThru();
+    ~MIDIThru();
+
+    // Routes the input to a channel of an output transposed by the given number of half notes; a NULL output disables routing
+    void setRoute(const QSharedPointer<MIDIInterface> &output, unsigned char channel, int transpose);
+
+    // Forwards a message to the output if it is a channel message; returns the output written to or NULL
+    MIDIInterface *route(const MIDIMessage &message);
+
+private:
+    // Stops the notes forwarded and not released yet; the mutex must be held
+    void stopNotes();
+
+    // Serializes changing the route and routing
+    QMutex mutex;
+    QSharedPointer<MIDIInterface> output;
+    unsigned char channel;
+    int transpose;
+    // The note sent for each received note being held; -1 if not held
+    signed char notes[128];
+};
+
+#endif // MIDITHRU_H
@@ -0,0 +1,80 @@
+/*
+ * miditracer.cpp
+ *
+ * Copyright 2002-2019 Vesa Halttunen
+ *
+ * This file is part of Tutka.
+ *
+ * Tutka is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tutka is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tutka; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <QFile>
+#include "miditracer.h"
+
+QAtomicPointer<MIDITracer> MIDITracer::tracer_;
+
+MIDITracer::MIDITracer() :
+    recorded(0)
+{
+    timer.start();
+}
+
+MIDITracer *MIDITracer::tracer()
+{
+    return tracer_.loadAcquire();
+}
+
+void MIDITracer::enable()
+{
+    if (tracer_.loadAcquire() == NULL) {
+        tracer_.storeRelease(new MIDITracer);
+    }
+}
+
+void MIDITracer::disable()
+{
+    delete tracer_.fetchAndStoreOrdered(NULL);
+}
+
+void MIDITracer::record(unsigned short interface, unsigned int tick, const unsigned char *data, int length)
+{
+    // Claim a slot; the oldest records are overwritten when the buffer is full
+    Record &record = records[recorded.fetchAndAddRelaxed(1) & (CAPACITY - 1)];
+
+    record.time = timer.nsecsElapsed();
+    record.tick = tick;
+    record.interface = interface;
+    record.length = length;
+    for (int i = 0; i < 4; i++) {
+        record.data[i] = i < 3 && i < length ? data[i] : 0;
+    }
+}
+
+bool MIDITracer::dump(const QString &path) const
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+
+    unsigned int recorded = this->recorded.loadAcquire();
+    unsigned int first = recorded > CAPACITY ? recorded - CAPACITY : 0;
+    for (unsigned int i = first; i < recorded; i++) {
+        file.write((const char *)&records[i & (CAPACITY - 1)], sizeof(Record));
+    }
+    file.close();
+
+    return true;
+}
@@ -0,0 +1,85 @@
+/*
+ * miditracer.h
+ *
+ * Copyright 2002-2019 Vesa Halttunen
+ *
+ * This file is part of Tutka.
+ *
+ * Tutka is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tutka is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tutka; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef MIDITRACER_H
+#define MIDITRACER_H
+
+#include <QAtomicInteger>
+#include <QAtomicPointer>
+#include <QElapsedTimer>
+#include <QString>
+
+// Records the MIDI messages written to the interfaces into a fixed size
+// ring buffer without formatting or allocating anything, so that what was
+// sent can be examined after a run. Tracing is enabled by setting the
+// TUTKA_MIDI_TRACE environment variable to the path of the dump file.
+class MIDITracer {
+public:
+    // Number of records kept; must be a power of two
+    enum {
+        CAPACITY = 65536
+    };
+
+    // A recorded message as written to the dump file (native byte order)
+    class Record {
+    public:
+        // Nanoseconds since tracing was enabled
+        qint64 time;
+        // Player tick the message was written on
+        unsigned int tick;
+        // Serial number of the interface the message was written to
+        unsigned short interface;
+        // Length of the message; only the first three bytes are recorded
+        unsigned short length;
+        unsigned char data[4];
+    };
+
+    // Returns the tracer or NULL if tracing is not enabled
+    static MIDITracer *tracer();
+
+    // Enables tracing
+    static void enable();
+
+    // Disables tracing and frees the recorded messages
+    static void disable();
+
+    // Records a message; may be called from any thread
+    void record(unsigned short interface, unsigned int tick, const unsigned char *data, int length);
+
+    // Writes the recorded messages to a file, oldest first; should not be called while messages are being recorded
+    bool dump(const QString &path) const;
+
+private:
+    MIDITracer();
+
+    // Recorded messages
+    Record records[CAPACITY];
+    // Number of messages recorded so far
+    QAtomicInteger<unsigned int> recorded;
+    // Time since tracing was enabled
+    QElapsedTimer timer;
+
+    // The tracer if tracing is enabled
+    static QAtomicPointer<MIDITracer> tracer_;
+};
+
+#endif // MIDITRACER_H
@@ -26,13 +26,12 @@
 #include <QCoreApplication>
 #include <QThread>
 #include <QTimer>
-#include <QFile>
 #include "song.h"
+#include "block.h"
 #include "track.h"
 #include "instrument.h"
 #include "midiinterface.h"
 #include "midi.h"
-#include "mmd.h"
 #include "conversion.h"
 #include "scheduler.h"
 #include "player.h"
@@ -45,26 +44,49 @@ Player::Player(MIDI *midi, const QString &path, QObject *parent) :
     block_(0),
     line_(0),
     tick(0),
+    tempo(120),
+    ticksPerLine(6),
     song(NULL),
     oldSong(NULL),
     mode_(ModeIdle),
     scheduler(NULL),
     syncMode(Off),
+    scheduling(false),
+    scheduleBase(0),
+    scheduleTicks(0),
+    scheduleTempo(0),
     ticksSoFar(0),
+    playedTickCount(0),
     externalSyncTicks(0),
     killThread(false),
     midi_(midi),
-    solo(0),
     postCommand(0),
     postValue(0),
     tempoChanged(false),
-    killWhenLooped(false)
+    killWhenLooped(false),
+    from_export(false),
+    exportOutputs(ExportOutputsSingle),
+    recordCheckpoints(false),
+    chaseState(NULL),
+    chaseTicks(-1),
+    chaseReached(false),
+    chaseSimulation(NULL),
+    songGeneration(1),
+    checkpointGeneration(0),
+    songPositionLocated(false),
+    checkpointBuilder(NULL)
 {
+    checkpointTimer.setSingleShot(true);
+    checkpointTimer.setInterval(1000);
+    connect(&checkpointTimer, SIGNAL(timeout()), this, SLOT(buildCheckpoints()));
     connect(midi, SIGNAL(outputsChanged()), this, SLOT(remapMidiOutputs()));
     connect(midi, SIGNAL(startReceived()), this, SLOT(playSong()));
     connect(midi, SIGNAL(continueReceived()), this, SLOT(continueSong()));
     connect(midi, SIGNAL(stopReceived()), this, SLOT(stop()));
-    connect(midi, SIGNAL(clockReceived()), this, SLOT(externalSync()));
+    connect(midi, SIGNAL(clockReceived(qint64)), this, SLOT(receiveClock(qint64)));
+    connect(midi, SIGNAL(songPositionReceived(unsigned int)), this, SLOT(setSongPosition(unsigned int)));
+    connect(midi, SIGNAL(outputEnabledChanged(bool)), this, SLOT(updateRouting()));
+    updateRouting();
 
     setSong(path);
 }
@@ -77,28 +99,47 @@ Player::Player(MIDI *midi, Song *song, bool from_export, QObject *parent) :
     block_(0),
     line_(0),
     tick(0),
+    tempo(120),
+    ticksPerLine(6),
     song(song),
     mode_(ModeIdle),
     scheduler(NULL),
     syncMode(Off),
+    scheduling(false),
+    scheduleBase(0),
+    scheduleTicks(0),
+    scheduleTempo(0),
     ticksSoFar(0),
+    playedTickCount(0),
     externalSyncTicks(0),
     killThread(false),
     midi_(midi),
-    solo(0),
     postCommand(0),
     postValue(0),
     tempoChanged(false),
     killWhenLooped(false),
-    from_export(from_export)
+    from_export(from_export),
+    exportOutputs(ExportOutputsSingle),
+    recordCheckpoints(false),
+    chaseState(NULL),
+    chaseTicks(-1),
+    chaseReached(false),
+    chaseSimulation(NULL),
+    songGeneration(1),
+    checkpointGeneration(0),
+    songPositionLocated(false),
+    checkpointBuilder(NULL)
 {
     connect(midi, SIGNAL(outputsChanged()), this, SLOT(remapMidiOutputs()));
+    connect(midi, SIGNAL(outputEnabledChanged(bool)), this, SLOT(updateRouting()));
     connect(qApp, SIGNAL(aboutToQuit()), this, SLOT(stop()));
-    QTimer::singleShot(0, this, SLOT(init()));
+    updateRouting();
 }
 
 Player::~Player()
 {
+    stopCheckpointBuilder();
+
     // Stop the player
     stop();
     wait();
@@ -111,23 +152,23 @@ void Player::updateLocation(bool alwaysSendLocationSignals)
     unsigned int oldPosition = position_;
     unsigned int oldBlock = block_;
 
-    if (section_ >= song->sections()) {
+    if (section_ >= snapshot->sections.count()) {
         section_ = 0;
     }
 
-    unsigned int playseq = song->section(section_);
-    if (playseq >= song->playseqs()) {
-        playseq = song->playseqs() - 1;
+    unsigned int playseq = snapshot->sections.at(section_);
+    if (playseq >= snapshot->playseqs.count()) {
+        playseq = snapshot->playseqs.count() - 1;
     }
     playseq_ = playseq;
 
-    if (position_ >= song->playseq(playseq_)->length()) {
+    if (position_ >= snapshot->playseqs.at(playseq_).count()) {
         position_ = 0;
     }
 
-    unsigned int block = song->playseq(playseq_)->at(position_);
-    if (block >= song->blocks()) {
-        block = song->blocks() - 1;
+    unsigned int block = snapshot->playseqs.at(playseq_).at(position_);
+    if (block >= snapshot->blocks.count()) {
+        block = snapshot->blocks.count() - 1;
     }
     block_ = block;
 
@@ -145,6 +186,16 @@ void Player::updateLocation(bool alwaysSendLocationSignals)
     }
 }
 
+bool Player::visitLocation()
+{
+    quint64 location = ((quint64)section_ << 48) | ((quint64)position_ << 32) | line_;
+    if (visitedLocations.contains(location)) {
+        return false;
+    }
+    visitedLocations.insert(location);
+    return true;
+}
+
 void Player::resetSection()
 {
     unsigned int oldSection = section_;
@@ -198,7 +249,7 @@ bool Player::nextSection()
     unsigned int oldSection = section_;
     section_++;
 
-    bool looped = section_ >= song->sections();
+    bool looped = section_ >= snapshot->sections.count();
     if (looped) {
         section_ = 0;
     }
@@ -215,7 +266,7 @@ bool Player::nextPosition()
     unsigned int oldPosition = position_;
     position_++;
 
-    bool looped = position_ >= song->playseq(playseq_)->length();
+    bool looped = position_ >= snapshot->playseqs.at(playseq_).count();
     if (looped) {
         position_ = 0;
     }
@@ -229,42 +280,55 @@ bool Player::nextPosition()
 
 void Player::playNote(unsigned int instrumentNumber, unsigned char note, unsigned char volume, unsigned char track, bool postpone)
 {
+    QSharedPointer<const SongSnapshot> snapshot = song->snapshot();
+
+    mutex.lock();
+    playNote(*snapshot, instrumentNumber, note, volume, track, postpone);
+    mutex.unlock();
+}
+
+void Player::playNote(const SongSnapshot &snapshot, unsigned int instrumentNumber, unsigned char note, unsigned char volume, unsigned char track, bool postpone)
+{
+    if (track >= snapshot.muted.count() || track >= trackStatuses.count()) {
+        return;
+    }
+
     // Notes are played if the track is not muted and no tracks are soloed or the current track is soloed
-    if (!song->track(track)->isMuted() && (!solo || (solo && song->track(track)->isSolo()))) {
-        QSharedPointer<TrackStatus> trackStatus = trackStatuses[track];
+    if (!snapshot.muted.at(track) && (!snapshot.solo || snapshot.soloed.at(track))) {
 
         // Stop currently playing note
-        if (trackStatus->note != -1) {
-            midi_->output(trackStatus->midiInterface)->noteOff(trackStatus->midiChannel, trackStatus->note, 127);
-            trackStatus->note = -1;
+        if (trackStatuses.note[track] != -1) {
+            output(trackStatuses.midiInterface[track])->noteOff(trackStatuses.midiChannel[track], trackStatuses.note[track], 127);
+            trackStatuses.note[track] = -1;
         }
 
         // Don't play a note if the instrument does not exist
-        Instrument *instrument = song->instrument(instrumentNumber);
-        if (instrument != NULL) {
-            trackStatus->instrument = instrumentNumber;
+        if (instrumentNumber < snapshot.holds.count() && instrumentNumber < routes.count() && instrumentNumber < instrumentVelocities.count()) {
+            const Route &route = routes.at(instrumentNumber);
+            trackStatuses.instrument[track] = instrumentNumber;
 
             // Update track status for the selected output
-            trackStatus->volume = instrument->defaultVelocity() * volume / 127 * song->track(track)->volume() / 127 * song->masterVolume() / 127;
-            trackStatus->midiChannel = instrument->midiChannel();
-            trackStatus->midiInterface = instrument->midiInterface();
-            trackStatus->hold = instrument->hold() > 0 ? instrument->hold() : -1;
+            trackStatuses.volume[track] = instrumentVelocities.at(instrumentNumber) * volume / 127 * trackStatuses.trackVolume.at(track) / 127 * snapshot.masterVolume / 127;
+            trackStatuses.midiChannel[track] = route.midiChannel;
+            trackStatuses.midiInterface[track] = routeInterface(route, track);
+            unsigned char hold = snapshot.holds.at(instrumentNumber);
+            trackStatuses.hold[track] = hold > 0 ? hold : -1;
 
             // Make sure the volume isn't too large
-            if (trackStatus->volume < 0) {
-                trackStatus->volume = 127;
+            if (trackStatuses.volume[track] < 0) {
+                trackStatuses.volume[track] = 127;
             }
 
-            if (trackStatus->volume != 0) {
+            if (trackStatuses.volume[track] != 0) {
                 // Play note
-                trackStatus->note = note + instrument->transpose();
+                trackStatuses.note[track] = note + snapshot.transposes.at(instrumentNumber);
                 if (postpone) {
-                    postponedNotes.append(NoteOn(instrument->midiInterface(), trackStatus->midiChannel, trackStatus->note, trackStatus->volume));
+                    postponedNotes.append(NoteOn(trackStatuses.midiInterface[track], trackStatuses.midiChannel[track], trackStatuses.note[track], trackStatuses.volume[track]));
                 } else {
-                    midi_->output(instrument->midiInterface())->noteOn(trackStatus->midiChannel, trackStatus->note, trackStatus->volume);
+                    output(trackStatuses.midiInterface[track])->noteOn(trackStatuses.midiChannel[track], trackStatuses.note[track], trackStatuses.volume[track]);
                 }
             } else {
-                trackStatus->note = -1;
+                trackStatuses.note[track] = -1;
             }
         }
     }
@@ -272,13 +336,13 @@ void Player::playNote(unsigned int instrumentNumber, unsigned char note, unsigne
 
 void Player::stopMuted()
 {
-    for (int track = 0; track < song->maxTracks(); track++) {
-        if (song->track(track)->isMuted() || (solo && !song->track(track)->isSolo())) {
-            QSharedPointer<TrackStatus> trackStatus = trackStatuses[track];
-            if (trackStatus->note != -1) {
-                midi_->output(trackStatus->midiInterface)->noteOff(trackStatus->midiChannel, trackStatus->note, 127);
+    int statusTracks = qMin(snapshot->muted.count(), trackStatuses.count());
+    for (int track = 0; track < statusTracks; track++) {
+        if (snapshot->muted.at(track) || (snapshot->solo && !snapshot->soloed.at(track))) {
+            if (trackStatuses.note[track] != -1) {
+                output(trackStatuses.midiInterface[track])->noteOff(trackStatuses.midiChannel[track], trackStatuses.note[track], 127);
             }
-            trackStatus->reset();
+            trackStatuses.reset(track);
         }
     }
 }
@@ -289,12 +353,12 @@ void Player::stopNotes()
         return;
     }
 
-    for (int track = 0; track < song->maxTracks(); track++) {
-        QSharedPointer<TrackStatus> trackStatus = trackStatuses[track];
-        if (trackStatus->note != -1) {
-            midi_->output(trackStatus->midiInterface)->noteOff(trackStatus->midiChannel, trackStatus->note, 127);
+    int statusTracks = qMin((int)song->maxTracks(), trackStatuses.count());
+    for (int track = 0; track < statusTracks; track++) {
+        if (trackStatuses.note[track] != -1) {
+            output(trackStatuses.midiInterface[track])->noteOff(trackStatuses.midiChannel[track], trackStatuses.note[track], 127);
         }
-        trackStatus->reset();
+        trackStatuses.reset(track);
     }
 }
 
@@ -302,8 +366,8 @@ void Player::stopAllNotes()
 {
     for (int midiChannel = 0; midiChannel < 16; midiChannel++) {
         for (int note = 0; note < 128; note++) {
-            for (int output = 0; output < midi_->outputs(); output++) {
-                midi_->output(output)->noteOff(midiChannel, note, 127);
+            for (int output = 0; output < activeOutputs.count(); output++) {
+                activeOutputs[output]->noteOff(midiChannel, note, 127);
             }
         }
     }
@@ -312,13 +376,13 @@ void Player::stopAllNotes()
 void Player::resetPitch()
 {
     for (int midiChannel = 0; midiChannel < 16; midiChannel++) {
-        for (int output = 0; output < midi_->outputs(); output++) {
-            midi_->output(output)->pitchWheel(midiChannel, 64);
+        for (int output = 0; output < activeOutputs.count(); output++) {
+            activeOutputs[output]->pitchWheel(midiChannel, 64);
         }
     }
 }
 
-void Player::handleCommand(QSharedPointer<TrackStatus> trackStatus, unsigned char note, unsigned char instrument, unsigned char command, unsigned char value, unsigned int *volume, int *delay, int *repeat, int *hold)
+void Player::handleCommand(unsigned int track, unsigned char note, unsigned char instrument, unsigned char command, unsigned char value, unsigned int *volume, int *delay, int *repeat, int *hold)
 {
     if (command == 0 && value == 0) {
         return;
@@ -330,27 +394,27 @@ void Player::handleCommand(QSharedPointer<TrackStatus> trackStatus, unsigned cha
     // Check which MIDI interface/channel pairs the command will affect
     if (instrument != 0) {
         // Instrument number defines MIDI interfaces/channels
-        midiInterface = song->instrument(instrument - 1)->midiInterface();
-        midiChannel = song->instrument(instrument - 1)->midiChannel();
+        Route route = instrument - 1 < routes.count() ? routes.at(instrument - 1) : Route();
+        midiInterface = routeInterface(route, track);
+        midiChannel = route.midiChannel;
     } else {
         // Note playing defines MIDI interfaces/channels
-        midiInterface = trackStatus->midiInterface;
-        midiChannel = trackStatus->midiChannel;
+        midiInterface = trackStatuses.midiInterface[track];
+        midiChannel = trackStatuses.midiChannel[track];
     }
 
     // If the MIDI interface is not known, use the null output interface
-    QSharedPointer<MIDIInterface> output = midi_->output(midiInterface >= 0 ? midiInterface : 0);
+    MIDIInterface *output = this->output(midiInterface);
 
     // Check for previous command if any
     if (command == CommandPreviousCommandValue) {
         if (value != 0) {
-            command = trackStatus->previousCommand;
+            command = trackStatuses.previousCommand[track];
         }
     } else {
-        trackStatus->previousCommand = command;
+        trackStatuses.previousCommand[track] = command;
     }
 
-    Track *track = song->track(trackStatus->track);
     switch (command) {
     case CommandPitchWheel:
         // Pitch wheel can be set if the MIDI channel is known
@@ -358,15 +422,15 @@ void Player::handleCommand(QSharedPointer<TrackStatus> trackStatus, unsigned cha
             if (value < 0x80) {
                 if (tick == 0) {
                     output->pitchWheel(midiChannel, value);
-                    midiControllerValues[midiInterface][midiChannel * VALUES + VALUES_PITCH_WHEEL] = value;
+                    setMidiControllerValue(midiInterface, midiChannel * VALUES + VALUES_PITCH_WHEEL, value);
                 }
             } else {
-                if (tick < song->ticksPerLine() - 1) {
-                    float delta = (value - 0x80 - midiControllerValues[midiInterface][midiChannel * VALUES + VALUES_PITCH_WHEEL]) / (float)song->ticksPerLine();
+                if (tick < ticksPerLine - 1) {
+                    float delta = (value - 0x80 - midiControllerValues[midiInterface][midiChannel * VALUES + VALUES_PITCH_WHEEL]) / (float)ticksPerLine;
                     output->pitchWheel(midiChannel, midiControllerValues[midiInterface][midiChannel * VALUES + VALUES_PITCH_WHEEL] + (tick + 1) * delta);
                 } else {
                     output->pitchWheel(midiChannel, value - 0x80);
-                    midiControllerValues[midiInterface][midiChannel * VALUES + VALUES_PITCH_WHEEL] = value - 0x80;
+                    setMidiControllerValue(midiInterface, midiChannel * VALUES + VALUES_PITCH_WHEEL, value - 0x80);
                 }
             }
         }
@@ -375,26 +439,27 @@ void Player::handleCommand(QSharedPointer<TrackStatus> trackStatus, unsigned cha
         // Program change can be sent if the MIDI channel is known
         if (midiChannel != -1 && tick == 0) {
             output->programChange(midiChannel, value & 0x7f);
+            setMidiControllerValue(midiInterface, midiChannel * VALUES + VALUES_PROGRAM, (value & 0x7f) + 1);
         }
         break;
     case CommandEndBlock:
         // Only on last tick
-        if (tick == song->ticksPerLine() - 1) {
+        if (tick == ticksPerLine - 1) {
             postCommand = CommandEndBlock;
             postValue = value;
         }
         break;
     case CommandPlayseqPosition:
         // Only on last tick
-        if (tick == song->ticksPerLine() - 1) {
+        if (tick == ticksPerLine - 1) {
             postCommand = CommandPlayseqPosition;
             postValue = value;
         }
         break;
     case CommandSendMessage:
         // Only on first tick
-        if (tick == 0 && value < song->messages()) {
-            output->writeRaw(song->message(value)->data());
+        if (tick == 0 && value < snapshot->messages.count()) {
+            output->writeRaw(snapshot->messages.at(value));
         }
         break;
     case CommandHold:
@@ -412,31 +477,31 @@ void Player::handleCommand(QSharedPointer<TrackStatus> trackStatus, unsigned cha
         if (note != 0) {
             *volume = value;
             if (midiChannel != -1) {
-                midiControllerValues[midiInterface][midiChannel * VALUES + VALUES_AFTERTOUCH] = value;
+                setMidiControllerValue(midiInterface, midiChannel * VALUES + VALUES_AFTERTOUCH, value);
             }
         } else {
             // Note playing defines MIDI channel
-            midiChannel = trackStatus->midiChannel;
+            midiChannel = trackStatuses.midiChannel[track];
 
             if (midiChannel != -1) {
                 if (value < 0x80) {
                     if (tick == 0) {
                         if (value > 0) {
-                            output->aftertouch(midiChannel, trackStatus->note, value);
-                            midiControllerValues[midiInterface][midiChannel * VALUES + VALUES_AFTERTOUCH] = value;
+                            output->aftertouch(midiChannel, trackStatuses.note[track], value);
+                            setMidiControllerValue(midiInterface, midiChannel * VALUES + VALUES_AFTERTOUCH, value);
                         } else {
-                            output->noteOff(midiChannel, trackStatus->note, 127);
-                            trackStatus->note = -1;
-                            trackStatus->line = -1;
+                            output->noteOff(midiChannel, trackStatuses.note[track], 127);
+                            trackStatuses.note[track] = -1;
+                            trackStatuses.line[track] = -1;
                         }
                     }
                 } else {
-                    if (tick < song->ticksPerLine() - 1) {
-                        float delta = (value - 0x80 - midiControllerValues[midiInterface][midiChannel * VALUES + VALUES_AFTERTOUCH]) / (float)song->ticksPerLine();
-                        output->aftertouch(midiChannel, trackStatus->note, midiControllerValues[midiInterface][midiChannel * VALUES + VALUES_AFTERTOUCH] + (tick + 1) * delta);
+                    if (tick < ticksPerLine - 1) {
+                        float delta = (value - 0x80 - midiControllerValues[midiInterface][midiChannel * VALUES + VALUES_AFTERTOUCH]) / (float)ticksPerLine;
+                        output->aftertouch(midiChannel, trackStatuses.note[track], midiControllerValues[midiInterface][midiChannel * VALUES + VALUES_AFTERTOUCH] + (tick + 1) * delta);
                     } else {
-                        output->aftertouch(midiChannel, trackStatus->note, value - 0x80);
-                        midiControllerValues[midiInterface][midiChannel * VALUES + VALUES_AFTERTOUCH] = value - 0x80;
+                        output->aftertouch(midiChannel, trackStatuses.note[track], value - 0x80);
+                        setMidiControllerValue(midiInterface, midiChannel * VALUES + VALUES_AFTERTOUCH, value - 0x80);
                     }
                 }
             }
@@ -448,15 +513,15 @@ void Player::handleCommand(QSharedPointer<TrackStatus> trackStatus, unsigned cha
             if (value < 0x80) {
                 if (tick == 0) {
                     output->channelPressure(midiChannel, value);
-                    midiControllerValues[midiInterface][midiChannel * VALUES + VALUES_CHANNEL_PRESSURE] = value;
+                    setMidiControllerValue(midiInterface, midiChannel * VALUES + VALUES_CHANNEL_PRESSURE, value);
                 }
             } else {
-                if (tick < song->ticksPerLine() - 1) {
-                    float delta = (value - 0x80 - midiControllerValues[midiInterface][midiChannel * VALUES + VALUES_CHANNEL_PRESSURE]) / (float)song->ticksPerLine();
+                if (tick < ticksPerLine - 1) {
+                    float delta = (value - 0x80 - midiControllerValues[midiInterface][midiChannel * VALUES + VALUES_CHANNEL_PRESSURE]) / (float)ticksPerLine;
                     output->channelPressure(midiChannel, midiControllerValues[midiInterface][midiChannel * VALUES + VALUES_CHANNEL_PRESSURE] + (tick + 1) * delta);
                 } else {
                     output->channelPressure(midiChannel, value - 0x80);
-                    midiControllerValues[midiInterface][midiChannel * VALUES + VALUES_CHANNEL_PRESSURE] = value - 0x80;
+                    setMidiControllerValue(midiInterface, midiChannel * VALUES + VALUES_CHANNEL_PRESSURE, value - 0x80);
                 }
             }
         }
@@ -464,52 +529,59 @@ void Player::handleCommand(QSharedPointer<TrackStatus> trackStatus, unsigned cha
     case CommandTicksPerLine:
         if (value == 0) {
             // Only on last tick
-            if (tick == song->ticksPerLine() - 1) {
+            if (tick == ticksPerLine - 1) {
                 postCommand = CommandTicksPerLine;
             }
         } else {
-            song->setTPL(value);
+            ticksPerLine = value;
         }
         break;
     case CommandTempo:
         if (value == 0) {
             // Only on last tick
-            if (tick == song->ticksPerLine() - 1) {
+            if (tick == ticksPerLine - 1) {
                 postCommand = CommandTempo;
             }
         } else {
-            song->setTempo(value);
-            output->tempo(value);
+            tempo = value;
+            // Exports with several tracks keep the tempo map in the conductor track
+            if (exportOutputs == ExportOutputsPerTrack || exportOutputs == ExportOutputsPerInstrument) {
+                this->output(0)->tempo(value);
+            } else {
+                output->tempo(value);
+            }
         }
         break;
-    case CommandTrackVolume:
+    case CommandTrackVolume: {
+        unsigned char &trackVolume = trackStatuses.trackVolume[track];
         if (value < 0x80) {
             if (tick == 0) {
-                track->setVolume(value);
+                trackVolume = value;
             }
         } else {
-            if (tick < song->ticksPerLine() - 1) {
-                float delta = (value - 0x80 - track->volume()) / (float)song->ticksPerLine();
-                track->setVolume(track->volume() + (tick + 1) * delta);
+            if (tick < ticksPerLine - 1) {
+                float delta = (value - 0x80 - trackVolume) / (float)ticksPerLine;
+                trackVolume = trackVolume + (tick + 1) * delta;
             } else {
-                track->setVolume(value - 0x80);
+                trackVolume = value - 0x80;
             }
         }
         break;
+    }
     case CommandInstrumentVolume: {
-        char trackInstrument = instrument != 0 ? (instrument - 1) : trackStatus->instrument;
-        Instrument *instrument = song->instrument(trackInstrument);
-        if (instrument != NULL) {
+        char trackInstrument = instrument != 0 ? (instrument - 1) : trackStatuses.instrument[track];
+        if (trackInstrument >= 0 && trackInstrument < instrumentVelocities.count()) {
+            unsigned char &velocity = instrumentVelocities[trackInstrument];
             if (value < 0x80) {
                 if (tick == 0) {
-                    instrument->setDefaultVelocity(value);
+                    velocity = value;
                 }
             } else {
-                if (tick < song->ticksPerLine() - 1) {
-                    float delta = (value - 0x80 - instrument->defaultVelocity()) / (float)song->ticksPerLine();
-                    instrument->setDefaultVelocity(track->volume() + (tick + 1) * delta);
+                if (tick < ticksPerLine - 1) {
+                    float delta = (value - 0x80 - velocity) / (float)ticksPerLine;
+                    velocity = velocity + (tick + 1) * delta;
                 } else {
-                    instrument->setDefaultVelocity(value - 0x80);
+                    velocity = value - 0x80;
                 }
             }
         }
@@ -524,15 +596,15 @@ void Player::handleCommand(QSharedPointer<TrackStatus> trackStatus, unsigned cha
             if (value < 0x80) {
                 if (tick == 0) {
                     output->controller(midiChannel, command - CommandMidiControllers, value);
-                    midiControllerValues[midiInterface][midiChannel * VALUES + command - CommandMidiControllers] = value;
+                    setMidiControllerValue(midiInterface, midiChannel * VALUES + command - CommandMidiControllers, value);
                 }
             } else {
-                if (tick < song->ticksPerLine() - 1) {
-                    float delta = (value - 0x80 - midiControllerValues[midiInterface][midiChannel * VALUES + command - CommandMidiControllers]) / (float)song->ticksPerLine();
+                if (tick < ticksPerLine - 1) {
+                    float delta = (value - 0x80 - midiControllerValues[midiInterface][midiChannel * VALUES + command - CommandMidiControllers]) / (float)ticksPerLine;
                     output->controller(midiChannel, command - CommandMidiControllers, midiControllerValues[midiInterface][midiChannel * VALUES + command - CommandMidiControllers] + (tick + 1) * delta);
                 } else {
                     output->controller(midiChannel, command - CommandMidiControllers, value - 0x80);
-                    midiControllerValues[midiInterface][midiChannel * VALUES + command - CommandMidiControllers] = value - 0x80;
+                    setMidiControllerValue(midiInterface, midiChannel * VALUES + command - CommandMidiControllers, value - 0x80);
                 }
             }
         }
@@ -550,11 +622,28 @@ void Player::run()
     unsigned int oldTime = (unsigned int)-1;
     unsigned int oldLine = line_;
 
-    tick = 0;
-    ticksSoFar = 0;
+    // Catch up with the location playing continues from before the time starts running
+    if (chaseSimulation != NULL) {
+        if (!finishChase()) {
+            return;
+        }
+        resetTime(false);
+    }
 
-    if (scheduler != NULL) {
-        scheduler->start(playingStarted);
+    Scheduler *runningScheduler = scheduler;
+    if (runningScheduler != NULL) {
+        runningScheduler->start(playingStarted);
+    }
+
+    // With a lookahead the backend delivers the messages at the tick times and the thread only has to wake up before them
+    scheduling = scheduler != NULL && midi()->canSchedule() && midi()->lookahead() > 0;
+    if (scheduling) {
+        startSchedule();
+    }
+
+    visitedLocations.clear();
+    if (killWhenLooped) {
+        visitLocation();
     }
 
     while (true) {
@@ -563,180 +652,260 @@ void Player::run()
 
         // Lock
         mutex.lock();
-        song->lock();
+
+        // Switch to a scheduler chosen while playing; the previous one is stopped so it releases the MIDI input it may hold
+        if (scheduler != runningScheduler) {
+            if (runningScheduler != NULL) {
+                runningScheduler->stop();
+            }
+            if (scheduler != NULL) {
+                struct timeval now;
+                gettimeofday(&now, NULL);
+                scheduler->start(now);
+            }
+            runningScheduler = scheduler;
+        }
 
         if (syncMode != Off) {
-            if (externalSyncTicks == 0) {
+            if (externalSyncTicks == 0 && scheduler != NULL && scheduler->readsInput()) {
+                // The scheduler reads the clock messages in this thread
+                mutex.unlock();
+                unsigned int clocks = scheduler->waitForClock();
+                qint64 time = ClockFollower::currentTime();
+                mutex.lock();
+                externalSyncTicks += clocks;
+                for (unsigned int clock = 0; clock < clocks; clock++) {
+                    clockFollower.clock(time);
+                }
+            } else if (externalSyncTicks == 0) {
                 // Wait for a sync signal to come in
                 externalSync_.wait(&mutex);
             }
             if (externalSyncTicks > 0) {
                 externalSyncTicks--;
+
+                // Play the tick when the clock follower expects the clock instead of when it happened to arrive
+                qint64 deadline = clockFollower.clockTime(clockFollower.clocks() - externalSyncTicks);
+                mutex.unlock();
+                ClockFollower::sleepUntil(deadline);
+                mutex.lock();
             }
         } else if (scheduler != NULL) {
-            song->unlock();
+            // The scheduler resets its timing when switching from external sync so the delivery timeline is restarted as well
+            if (scheduling && syncMode != prevsyncMode) {
+                startSchedule();
+            }
+
             mutex.unlock();
 
-            scheduler->waitForTick(song, syncMode != prevsyncMode);
+            scheduler->waitForTick(tempo, syncMode != prevsyncMode);
             prevsyncMode = syncMode;
 
             mutex.lock();
-            song->lock();
         }
 
-        // Handle this tick
-        for (int output = 0; output < midi_->outputs(); output++) {
-            midi_->output(output)->setTick(ticksSoFar);
+        // Play this tick from the most recently published version of the song; exports play the version they started with
+        if (!from_export) {
+            snapshot = song->snapshot();
+        }
+
+        // When simulating store the state at the given tick or at the beginning of the given line
+        if (chaseState != NULL && chaseTicks >= 0 && ticksSoFar >= chaseTicks) {
+            *chaseState = state();
+            chaseReached = true;
+            break;
+        }
+        if (tick == 0 && chaseState != NULL && chaseTicks < 0 && section_ == chaseState->section && position_ == chaseState->position && line_ == chaseState->line) {
+            *chaseState = state();
+            chaseReached = true;
+            break;
+        }
+        if (tick == 0 && recordCheckpoints) {
+            quint64 key = ((quint64)section_ << 32) | position_;
+            if (!checkpointIndex.contains(key)) {
+                checkpointIndex.insert(key, checkpoints.count());
+                checkpoints.append(state());
+            }
         }
 
-        Block *block = song->block(block_);
-        int commandPages = block->commandPages();
+        // Handle this tick; externally synced ticks are sent immediately
+        qint64 tickTime = scheduling && syncMode == Off ? scheduleTick() : -1;
+        for (int output = 0; output < activeOutputs.count(); output++) {
+            activeOutputs[output]->setTime(tickTime);
+            activeOutputs[output]->beginTick(ticksSoFar);
+        }
+
+        const BlockTimeline *block = snapshot->blocks.at(block_ < snapshot->blocks.count() ? block_ : (snapshot->blocks.count() - 1)).data();
 
         // Send MIDI sync if requested
-        if (song->sendSync()) {
-            for (int output = 0; output < midi_->outputs(); output++) {
-                midi_->output(output)->clock();
+        if (snapshot->sendSync) {
+            for (int output = 0; output < activeOutputs.count(); output++) {
+                activeOutputs[output]->clock();
             }
         }
 
         // The block may have changed, make sure the line won't overflow
-        if (line_ >= block->length()) {
-            line_ %= block->length();
+        if (line_ >= block->lines()) {
+            line_ %= block->lines();
         }
 
-        for (int track = 0; track < block->tracks(); track++) {
-            QSharedPointer<TrackStatus> trackStatus = trackStatuses[track];
+        // Remember where this tick is for recording input
+        if (!from_export) {
+            recordPlayedTick();
+        }
+
+        // Only the tracks that have something on the current line or a running arpeggio need to be handled
+        const BlockTimeline::Line &timelineLine = block->line(line_);
+        const BlockTimeline::Cell *cell = timelineLine.cells.constData();
+        const BlockTimeline::Cell *cellsEnd = cell + timelineLine.cells.count();
+        const BlockTimeline::Command *commands = timelineLine.commands.constData();
+
+        int tracks = block->tracks() < trackStatuses.count() ? block->tracks() : trackStatuses.count();
+        for (int track = 0; track < tracks; track++) {
+            const BlockTimeline::Cell *trackCell = NULL;
+            if (cell != cellsEnd && cell->track == track) {
+                trackCell = cell++;
+            } else if (trackStatuses.line[track] < 0) {
+                continue;
+            }
 
             // The track is taken into account if the track is not muted and no tracks are soloed or the current track is soloed
-            if (!song->track(track)->isMuted() && (!solo || (solo && song->track(track)->isSolo()))) {
+            if (track < snapshot->muted.count() && !snapshot->muted.at(track) && (!snapshot->solo || snapshot->soloed.at(track))) {
                 unsigned int volume = 127;
                 int delay = 0, repeat = -1, hold = -1;
-                unsigned char basenote = block->note(line_, track);
-                unsigned char instrument = block->instrument(line_, track);
+                unsigned char basenote = trackCell != NULL ? trackCell->note : 0;
+                unsigned char instrument = trackCell != NULL ? trackCell->instrument : 0;
+                const BlockTimeline::Command *trackCommands = trackCell != NULL ? commands + trackCell->firstCommand : NULL;
+                int trackCommandCount = trackCell != NULL ? trackCell->commands : 0;
                 unsigned char note = basenote;
-                Block *arpeggio = NULL;
+                const BlockTimeline *arpeggio = NULL;
+                const BlockTimeline::Cell *arpeggioCell = NULL;
+                const BlockTimeline::Command *arpeggioCommands = NULL;
 
                 if (note != 0) {
                     // Start the arpeggio from the beginning if a note is played on the track
                     if (tick == 0) {
-                        trackStatus->line = 0;
+                        trackStatuses.line[track] = 0;
                     }
                 } else {
-                    basenote = trackStatus->baseNote;
+                    basenote = trackStatuses.baseNote[track];
                 }
 
-                int arpeggioInstrument = note != 0 && instrument > 0 ? (instrument - 1) : trackStatus->instrument;
-                if (arpeggioInstrument >= 0 && trackStatus->line >= 0) {
+                int arpeggioInstrument = note != 0 && instrument > 0 ? (instrument - 1) : trackStatuses.instrument[track];
+                if (arpeggioInstrument >= 0 && trackStatuses.line[track] >= 0) {
                     // Add arpeggio note (if any) to the track's base note
-                    arpeggio = song->instrument(arpeggioInstrument)->arpeggio();
+                    arpeggio = arpeggioInstrument < snapshot->arpeggios.count() ? snapshot->arpeggios.at(arpeggioInstrument).data() : NULL;
                     if (arpeggio != NULL) {
-                        unsigned char arpeggioNote = arpeggio->note(trackStatus->line, 0);
-                        note = arpeggioNote != 0 ? (basenote + ((char)arpeggioNote - (char)song->instrument(arpeggioInstrument)->arpeggioBaseNote())) : 0;
+                        // The arpeggio may have been shortened since the line was advanced
+                        if (trackStatuses.line[track] >= arpeggio->lines()) {
+                            trackStatuses.line[track] = 0;
+                        }
+                        const BlockTimeline::Line &arpeggioLine = arpeggio->line(trackStatuses.line[track]);
+                        if (!arpeggioLine.cells.isEmpty() && arpeggioLine.cells.first().track == 0) {
+                            arpeggioCell = &arpeggioLine.cells.first();
+                            arpeggioCommands = arpeggioLine.commands.constData() + arpeggioCell->firstCommand;
+                        }
+                        unsigned char arpeggioNote = arpeggioCell != NULL ? arpeggioCell->note : 0;
+                        note = arpeggioNote != 0 ? (basenote + ((char)arpeggioNote - (char)snapshot->arpeggioBaseNotes.at(arpeggioInstrument))) : 0;
                     }
                 }
 
                 // Stop notes if there are new notes about to be played
                 if (note != 0) {
-                    for (int commandPage = 0; commandPage < commandPages; commandPage++) {
-                        unsigned char command = block->command(line_, track, commandPage);
-                        unsigned char value = block->commandValue(line_, track, commandPage);
-
-                        if (command != 0 || value != 0) {
-                            // Check for previous command if any
-                            if (command == CommandPreviousCommandValue) {
-                                if (value != 0) {
-                                    command = trackStatus->previousCommand;
-                                }
-                            } else {
-                                trackStatus->previousCommand = command;
+                    for (int i = 0; i < trackCommandCount; i++) {
+                        unsigned char command = trackCommands[i].command;
+                        unsigned char value = trackCommands[i].value;
+
+                        // Check for previous command if any
+                        if (command == CommandPreviousCommandValue) {
+                            if (value != 0) {
+                                command = trackStatuses.previousCommand[track];
                             }
+                        } else {
+                            trackStatuses.previousCommand[track] = command;
+                        }
 
-                            switch (command) {
-                            case CommandRetrigger:
-                                delay = (value & 0xf0) >> 4;
-                                repeat = value & 0x0f;
-                                break;
-                            case CommandDelay:
-                                delay = value;
-                                repeat = -1;
-                                break;
-                            }
+                        switch (command) {
+                        case CommandRetrigger:
+                            delay = (value & 0xf0) >> 4;
+                            repeat = value & 0x0f;
+                            break;
+                        case CommandDelay:
+                            delay = value;
+                            repeat = -1;
+                            break;
                         }
                     }
 
                     // Stop currently playing note
                     if (shouldPlayNote(tick, delay, repeat)) {
-                        if (trackStatus->note != -1) {
-                            midi_->output(trackStatus->midiInterface)->noteOff(trackStatus->midiChannel, trackStatus->note, 127);
-                            trackStatus->note = -1;
+                        if (trackStatuses.note[track] != -1) {
+                            output(trackStatuses.midiInterface[track])->noteOff(trackStatuses.midiChannel[track], trackStatuses.note[track], 127);
+                            trackStatuses.note[track] = -1;
                         }
                     }
                 }
 
-                if (arpeggio != NULL) {
+                if (arpeggioCell != NULL) {
                     // Handle commands on all arpeggio command pages
-                    for (int commandPage = 0; commandPage < arpeggio->commandPages(); commandPage++) {
-                        unsigned char command = arpeggio->command(trackStatus->line, 0, commandPage);
-                        unsigned char value = arpeggio->commandValue(trackStatus->line, 0, commandPage);
-                        handleCommand(trackStatus, note, instrument, command, value, &volume, &delay, &repeat, &hold);
+                    for (int i = 0; i < arpeggioCell->commands; i++) {
+                        handleCommand(track, note, instrument, arpeggioCommands[i].command, arpeggioCommands[i].value, &volume, &delay, &repeat, &hold);
                     }
                 }
 
                 bool hadVolume = volume > 0;
                 // Handle commands on all command pages
-                for (int commandPage = 0; commandPage < commandPages; commandPage++) {
-                    unsigned char command = block->command(line_, track, commandPage);
-                    unsigned char value = block->commandValue(line_, track, commandPage);
-                    handleCommand(trackStatus, note, instrument, command, value, &volume, &delay, &repeat, &hold);
+                for (int i = 0; i < trackCommandCount; i++) {
+                    handleCommand(track, note, instrument, trackCommands[i].command, trackCommands[i].value, &volume, &delay, &repeat, &hold);
                 }
 
                 // Set the channel base note and instrument regardless of whether there's an actual note to be played right now
                 if (basenote != 0) {
-                    trackStatus->baseNote = basenote;
+                    trackStatuses.baseNote[track] = basenote;
                     if (instrument != 0) {
-                        trackStatus->instrument = instrument - 1;
+                        trackStatuses.instrument[track] = instrument - 1;
                     }
                 }
 
                 // Is there a note to play?
                 if (note != 0 && shouldPlayNote(tick, delay, repeat)) {
-                    Instrument *instr = NULL;
+                    int instrumentHold = -1;
 
                     note--;
 
                     // Use previous instrument if none defined
                     if (instrument == 0) {
-                        instrument = trackStatus->instrument + 1;
+                        instrument = trackStatuses.instrument[track] + 1;
                     }
 
                     // Play note if instrument is defined
                     if (instrument != 0) {
-                        playNote(instrument - 1, note, volume, track, true);
+                        playNote(*snapshot, instrument - 1, note, volume, track, true);
 
-                        if (instrument <= song->instruments()) {
-                            instr = song->instrument(instrument - 1);
+                        if (instrument <= snapshot->holds.count()) {
+                            instrumentHold = snapshot->holds.at(instrument - 1);
                         }
                     }
 
-                    if (instr != NULL) {
+                    if (instrumentHold >= 0) {
                         // If no hold value was defined use the instrument's hold value
                         if (hold == -1) {
-                            hold = instr->hold();
+                            hold = instrumentHold;
                         }
 
-                        trackStatus->hold = hold == 0 ? -1 : hold;
+                        trackStatuses.hold[track] = hold == 0 ? -1 : hold;
 
                         // If there would have been volume but the block's commands killed it, stop the arpeggio
                         if (hadVolume && volume == 0) {
-                            trackStatus->line = -1;
+                            trackStatuses.line[track] = -1;
                         }
                     }
                 }
 
                 // First tick, no note but instrument defined?
-                if (tick == 0 && note == 0 && instrument > 0 && trackStatus->hold >= 0) {
-                    if (song->instrument(instrument - 1)->midiInterface() == trackStatus->midiInterface) {
-                        trackStatus->hold += song->instrument(instrument - 1)->hold();
+                if (tick == 0 && note == 0 && instrument > 0 && trackStatuses.hold[track] >= 0) {
+                    if (instrument - 1 < routes.count() && routeInterface(routes.at(instrument - 1), track) == trackStatuses.midiInterface[track]) {
+                        trackStatuses.hold[track] += instrument - 1 < snapshot->holds.count() ? snapshot->holds.at(instrument - 1) : 0;
                     }
                 }
             }
@@ -745,26 +914,33 @@ void Player::run()
         // Play notes scheduled to be played
         for (int i = 0; i < postponedNotes.count(); i++) {
             const NoteOn &noteOn = postponedNotes.at(i);
-            midi_->output(noteOn.midiInterface)->noteOn(noteOn.midiChannel, noteOn.note, noteOn.volume);
+            output(noteOn.midiInterface)->noteOn(noteOn.midiChannel, noteOn.note, noteOn.volume);
         }
         postponedNotes.clear();
 
         // Decrement hold times of notes and stop notes that should be stopped
-        for (int track = 0; track < song->maxTracks(); track++) {
-            QSharedPointer<TrackStatus> trackStatus = trackStatuses[track];
-            if (trackStatus->hold >= 0) {
-                trackStatus->hold--;
-                if (trackStatus->hold < 0 && trackStatus->note != -1) {
-                    midi_->output(trackStatus->midiInterface)->noteOff(trackStatus->midiChannel, trackStatus->note, 127);
-                    trackStatus->note = -1;
+        int *holds = trackStatuses.hold.data();
+        char *notes = trackStatuses.note.data();
+        int statusTracks = qMin(snapshot->muted.count(), trackStatuses.count());
+        for (int track = 0; track < statusTracks; track++) {
+            if (holds[track] >= 0) {
+                holds[track]--;
+                if (holds[track] < 0 && notes[track] != -1) {
+                    output(trackStatuses.midiInterface[track])->noteOff(trackStatuses.midiChannel[track], notes[track], 127);
+                    notes[track] = -1;
                 }
             }
         }
 
+        // Send everything written during this tick
+        for (int output = 0; output < activeOutputs.count(); output++) {
+            activeOutputs[output]->flush();
+        }
+
         // Next tick
         ticksSoFar++;
         tick++;
-        tick %= song->ticksPerLine();
+        tick %= ticksPerLine;
 
         // Advance and handle post commands if ticksperline ticks have passed
         if (tick == 0) {
@@ -773,15 +949,14 @@ void Player::run()
             line_++;
 
             // Advance arpeggios
-            for (int track = 0; track < song->maxTracks(); track++) {
-                QSharedPointer<TrackStatus> trackStatus = trackStatuses[track];
-                int arpeggioInstrument = trackStatus->instrument;
-
-                if (arpeggioInstrument >= 0 && trackStatus->baseNote >= 0 && trackStatus->line >= 0) {
-                    Instrument *instrument = song->instrument(arpeggioInstrument);
-                    if (instrument->arpeggio() != NULL) {
-                        trackStatus->line++;
-                        trackStatus->line %= instrument->arpeggio()->length();
+            for (int track = 0; track < statusTracks; track++) {
+                int arpeggioInstrument = trackStatuses.instrument[track];
+
+                if (arpeggioInstrument >= 0 && trackStatuses.baseNote[track] >= 0 && trackStatuses.line[track] >= 0 && arpeggioInstrument < snapshot->arpeggios.count()) {
+                    const BlockTimeline *arpeggio = snapshot->arpeggios.at(arpeggioInstrument).data();
+                    if (arpeggio != NULL) {
+                        trackStatuses.line[track]++;
+                        trackStatuses.line[track] %= arpeggio->lines();
                     }
                 }
             }
@@ -797,7 +972,7 @@ void Player::run()
             case CommandPlayseqPosition:
                 line_ = 0;
                 position_ = postValue;
-                if (position_ >= song->playseq(playseq_)->length()) {
+                if (position_ >= snapshot->playseqs.at(playseq_).count()) {
                     position_ = 0;
                     looped = nextSection();
                 }
@@ -809,7 +984,7 @@ void Player::run()
                 break;
             default:
                 // Advance in block
-                if (line_ >= song->block(block_)->length()) {
+                if (line_ >= block->lines()) {
                     line_ = 0;
                     if (mode_ == ModePlaySong) {
                         looped = nextPosition();
@@ -823,6 +998,11 @@ void Player::run()
 
             if (changeBlock) {
                 updateLocation();
+
+                // A position command jumping back to an earlier block would never wrap the song
+                if (killWhenLooped && !looped) {
+                    looped = !visitLocation();
+                }
             }
         }
 
@@ -830,7 +1010,6 @@ void Player::run()
         if (killThread || (killWhenLooped && looped)) {
             break;
         }
-        song->unlock();
         mutex.unlock();
 
         if (line_ != oldLine) {
@@ -867,15 +1046,30 @@ void Player::run()
         playedSoFar.tv_usec -= 1000000;
     }
 
-    if (scheduler != NULL) {
-        scheduler->stop();
+    if (runningScheduler != NULL) {
+        runningScheduler->stop();
+    }
+
+    // Stopping drops what hasn't been heard yet; when the song ends by itself it plays out before the notes are stopped
+    if (scheduling && mode_ == ModeIdle) {
+        midi()->discardSchedule();
+        for (int output = 0; output < activeOutputs.count(); output++) {
+            activeOutputs[output]->setTime(-1);
+        }
     }
 
     // Stop all playing notes
     stopNotes();
 
+    // Messages written outside playback are sent immediately
+    if (scheduling) {
+        for (int output = 0; output < activeOutputs.count(); output++) {
+            activeOutputs[output]->setTime(-1);
+        }
+        scheduling = false;
+    }
+
     // The mutex is locked if the thread was killed and loop broken
-    song->unlock();
     mutex.unlock();
 
     if (line_ != oldLine) {
@@ -883,15 +1077,17 @@ void Player::run()
     }
 }
 
-void Player::playWithoutScheduling()
+void Player::playWithoutScheduling(ExportOutputs exportOutputs)
 {
     scheduler = NULL;
     mode_ = ModePlaySong;
     killWhenLooped = true;
-    for (int instrument = 0; instrument < song->instruments(); instrument++) {
-        song->instrument(instrument)->setMidiInterface(0);
-    }
-    midi_->output(0)->tempo(song->tempo());
+    this->exportOutputs = exportOutputs;
+    updateRouting();
+    resetPlaybackState();
+    tick = 0;
+    ticksSoFar = 0;
+    output(0)->tempo(tempo);
     run();
     stopNotes();
 }
@@ -899,10 +1095,12 @@ void Player::playWithoutScheduling()
 void Player::play(Mode mode, bool cont)
 {
     stop();
+    resetPlaybackState();
 
     Mode oldMode = mode_;
     int oldLine = line_;
     mode_ = mode;
+    snapshot = song->snapshot();
     tick = 0;
     ticksSoFar = 0;
 
@@ -928,9 +1126,31 @@ void Player::play(Mode mode, bool cont)
         emit lineChanged(line_);
     }
 
+    // Continuing a song picks up the state the earlier lines would have set up; a located song position has it ready
+    if (cont && mode == ModePlaySong && !from_export) {
+        if (songPositionLocated && songPosition.section == section_ && songPosition.position == position_ && songPosition.line == line_) {
+            restoreState(songPosition, false);
+            tick = songPosition.tick;
+        } else {
+            chase();
+        }
+    }
+    songPositionLocated = false;
+
     // Get the starting time
     resetTime(!cont);
 
+    // Lock to the external clock again; the master may have changed its tempo while stopped
+    mutex.lock();
+    externalSyncTicks = 0;
+    clockFollower.reset();
+    mutex.unlock();
+
+    // Input can only be mapped to the ticks played from now on
+    playedTicksMutex.lock();
+    playedTickCount = 0;
+    playedTicksMutex.unlock();
+
     // Send MIDI start or continue if sync is requested
     if (mode != ModeIdle && song->sendSync()) {
         if (cont) {
@@ -957,9 +1177,14 @@ void Player::stop()
     }
 
     if (isRunning()) {
-        // Mark the thread for killing
+        // Mark the thread for killing; a chase still running is stopped as well
         mutex.lock();
         killThread = true;
+        if (chaseSimulation != NULL) {
+            chaseSimulation->mutex.lock();
+            chaseSimulation->killThread = true;
+            chaseSimulation->mutex.unlock();
+        }
         mutex.unlock();
 
         // If external sync is used send sync to get out of the sync wait loop
@@ -968,7 +1193,7 @@ void Player::stop()
         }
 
         // Send MIDI stop if sync is requested
-        if (song->sendSync()) {
+        if (song->sendSync() && !from_export) {
             midi()->stop();
         }
 
@@ -1004,15 +1229,21 @@ void Player::trackStatusCreate(bool recreateAll)
 {
     int maxTracks = song != NULL ? song->maxTracks() : 0;
 
+    mutex.lock();
+
     // Free the extraneous status structures
-    while (trackStatuses.count() > (recreateAll ? 0 : maxTracks)) {
-        trackStatuses.removeLast();
+    if (recreateAll) {
+        trackStatuses.resize(0);
     }
 
-    // Set new tracks to -1
-    for (unsigned int track = trackStatuses.count(); track < maxTracks; track++) {
-        trackStatuses.append(QSharedPointer<TrackStatus>(new TrackStatus(track)));
+    // Set new tracks to -1 and their volumes to those of the song
+    int oldTracks = trackStatuses.count();
+    trackStatuses.resize(maxTracks);
+    for (int track = oldTracks; track < maxTracks; track++) {
+        trackStatuses.trackVolume[track] = song->track(track)->volume();
     }
+
+    mutex.unlock();
 }
 
 void Player::setSong(const QString &path)
@@ -1022,25 +1253,10 @@ void Player::setSong(const QString &path)
     }
 
     stop();
+    stopCheckpointBuilder();
 
     oldSong = song;
-    song = NULL;
-
-    QFile file(path);
-    if (file.exists()) {
-        file.open(QIODevice::ReadOnly);
-        QByteArray header = file.read(4);
-        if (header.length() == 4) {
-            const char *data = header.data();
-            if (data[0] == (ID_MMD2 >> 24) && data[1] == ((ID_MMD2 >> 16) & 0xff) && data[2] == ((ID_MMD2 >> 8) & 0xff) && (data[3] == (ID_MMD0 & 0xff) || data[3] == (ID_MMD1 & 0xff) || data[3] == (ID_MMD2 & 0xff))) {
-                song = mmd2ToSong(MMD2_load(path.toUtf8().constData()));
-            }
-        }
-    }
-
-    if (song == NULL) {
-        song = new Song(path);
-    }
+    song = loadSong(path);
 
     QTimer::singleShot(0, this, SLOT(init()));
 }
@@ -1051,22 +1267,35 @@ void Player::init()
     connect(song, SIGNAL(blocksChanged(int)), this, SLOT(resetBlock()));
     connect(song, SIGNAL(playseqsChanged(int)), this, SLOT(resetPlayseq()));
     connect(song, SIGNAL(sectionsChanged(uint)), this, SLOT(resetSection()));
-    connect(song, SIGNAL(trackMutedOrSoloed()), this, SLOT(checkSolo()));
+    connect(song, SIGNAL(instrumentRoutingChanged()), this, SLOT(updateRouting()));
+    connect(song, SIGNAL(instrumentRoutingChanged()), this, SLOT(resetInstrumentVelocities()));
+    connect(song, SIGNAL(instrumentVelocityChanged()), this, SLOT(resetInstrumentVelocities()));
+    connect(song, SIGNAL(trackVolumeChanged()), this, SLOT(resetTrackVolumes()));
+    connect(song, SIGNAL(tempoChanged()), this, SLOT(resetTempo()));
+    connect(song, SIGNAL(ticksPerLineChanged()), this, SLOT(resetTicksPerLine()));
+    if (!from_export) {
+        connect(song, SIGNAL(snapshotChanged()), this, SLOT(invalidateCheckpoints()));
+        connect(song, SIGNAL(instrumentRoutingChanged()), this, SLOT(invalidateCheckpoints()));
+        connect(song, SIGNAL(instrumentVelocityChanged()), this, SLOT(invalidateCheckpoints()));
+        connect(song, SIGNAL(trackVolumeChanged()), this, SLOT(invalidateCheckpoints()));
+        connect(song, SIGNAL(trackMutedOrSoloed()), this, SLOT(invalidateCheckpoints()));
+        connect(song, SIGNAL(tempoChanged()), this, SLOT(invalidateCheckpoints()));
+        connect(song, SIGNAL(ticksPerLineChanged()), this, SLOT(invalidateCheckpoints()));
+        connect(song, SIGNAL(maxTracksChanged(uint)), this, SLOT(invalidateCheckpoints()));
+    }
 
     remapMidiOutputs();
 
     // Recreate the track status array
     trackStatusCreate(true);
     connect(this->song, SIGNAL(maxTracksChanged(uint)), this, SLOT(trackStatusCreate()));
-
-    // Check solo status
-    checkSolo();
+    resetPlaybackState();
 
     // Send messages to be autosent
     for (int message = 0; message < song->messages(); message++) {
         if (song->message(message)->isAutoSend()) {
-            for (int output = 0; output < midi_->outputs(); output++) {
-                midi_->output(output)->writeRaw(song->message(message)->data());
+            for (int output = 0; output < activeOutputs.count(); output++) {
+                activeOutputs[output]->writeRaw(song->message(message)->data());
             }
         }
     }
@@ -1079,6 +1308,7 @@ void Player::init()
     line_ = 0;
 
     emit songChanged(song);
+    snapshot = song->snapshot();
     updateLocation(true);
     if (!from_export) {
       delete oldSong;
@@ -1100,6 +1330,9 @@ void Player::setSection(int section)
     }
 
     section_ = section;
+    if (section_ != oldSection) {
+        discardSchedule();
+    }
 
     mutex.unlock();
 
@@ -1146,6 +1379,9 @@ void Player::setPosition(int position)
     }
 
     position_ = position;
+    if (position_ != oldPosition) {
+        discardSchedule();
+    }
 
     mutex.unlock();
 
@@ -1168,6 +1404,9 @@ void Player::setBlock(int block)
     }
 
     block_ = block;
+    if (block_ != oldBlock) {
+        discardSchedule();
+    }
 
     mutex.unlock();
 
@@ -1199,6 +1438,9 @@ void Player::setLine(int line, bool wrap)
     }
 
     line_ = line;
+    if (line_ != oldLine) {
+        discardSchedule();
+    }
 
     mutex.unlock();
 
@@ -1224,37 +1466,445 @@ void Player::resetTime(bool resetSofar)
     }
 }
 
-void Player::checkSolo()
-{
-    int solo = 0;
-
-    for (int track = 0; track < song->maxTracks(); track++) {
-        solo |= song->track(track)->isSolo();
-    }
-
-    this->solo = solo;
-}
-
 void Player::remapMidiOutputs()
 {
-    for (int instrument = 0; instrument < song->instruments(); instrument++) {
+    // Exports route the instruments themselves and leave the song untouched. Outputs keep their numbers
+    // when ports come and go, so this only changes instruments whose output has just appeared.
+    for (int instrument = 0; instrument < song->instruments() && !from_export; instrument++) {
         int output = midi_->output(song->instrument(instrument)->midiInterfaceName());
         if (output >= 0) {
             song->instrument(instrument)->setMidiInterface(output);
         }
     }
 
-    // Recreate the track status array
-    trackStatusCreate();
+    // The player thread may be using the controller values
+    mutex.lock();
+    int outputs = midiControllerValues.count();
 
     // Remove extraneous controller values
     while (midi_->outputs() < midiControllerValues.count()) {
         midiControllerValues.removeLast();
+        midiControllersSet.removeLast();
     }
 
     // Create new controller values
     for (int output = midiControllerValues.count(); output < midi_->outputs(); output++) {
         midiControllerValues.append(QVector<unsigned char>(16 * VALUES));
+        midiControllersSet.append(QBitArray(16 * VALUES));
+    }
+    bool outputsChanged = outputs != midiControllerValues.count();
+    mutex.unlock();
+
+    updateRouting();
+
+    // Checkpoints have controller values for each output
+    if (outputsChanged) {
+        invalidateCheckpoints();
+    }
+}
+
+void Player::updateRouting()
+{
+    // The routing is built first and swapped in at once so the player thread only waits for the swap
+    QList<QSharedPointer<MIDIInterface> > outputReferences;
+    QVector<MIDIInterface *> outputs;
+    QVector<MIDIInterface *> activeOutputs;
+    QVector<Route> routes;
+    for (unsigned int output = 0; output < midi_->outputs(); output++) {
+        QSharedPointer<MIDIInterface> interface = midi_->output(output);
+        if (from_export && exportOutputs == ExportOutputsNone) {
+            // Simulations have the same outputs but write nothing
+            if (silentOutput.isNull()) {
+                silentOutput = QSharedPointer<MIDIInterface>(new MIDIInterface(MIDIInterface::Output));
+            }
+            interface = silentOutput;
+        }
+        outputReferences.append(interface);
+        outputs.append(interface.data());
+        if (interface->isEnabled()) {
+            activeOutputs.append(interface.data());
+        }
+    }
+
+    if (song != NULL) {
+        for (int instrument = 0; instrument < song->instruments(); instrument++) {
+            int midiInterface = song->instrument(instrument)->midiInterface();
+            if (from_export && exportOutputs != ExportOutputsNone) {
+                midiInterface = exportOutputs == ExportOutputsPerInstrument ? instrument + 1 : 0;
+            }
+            routes.append(Route(midiInterface, song->instrument(instrument)->midiChannel()));
+        }
+    }
+
+    // The previous routing is released after unlocking
+    mutex.lock();
+    this->outputReferences.swap(outputReferences);
+    this->outputs.swap(outputs);
+    this->activeOutputs.swap(activeOutputs);
+    this->routes.swap(routes);
+    mutex.unlock();
+}
+
+void Player::resetPlaybackState()
+{
+    if (song == NULL) {
+        return;
+    }
+
+    mutex.lock();
+
+    tempo = song->tempo();
+    ticksPerLine = song->ticksPerLine();
+
+    for (int track = 0; track < trackStatuses.count() && track < song->maxTracks(); track++) {
+        trackStatuses.trackVolume[track] = song->track(track)->volume();
+    }
+
+    instrumentVelocities.resize(song->instruments());
+    for (int instrument = 0; instrument < song->instruments(); instrument++) {
+        instrumentVelocities[instrument] = song->instrument(instrument)->defaultVelocity();
+    }
+
+    mutex.unlock();
+}
+
+void Player::resetTempo()
+{
+    mutex.lock();
+    tempo = song->tempo();
+    mutex.unlock();
+}
+
+void Player::resetTicksPerLine()
+{
+    mutex.lock();
+    ticksPerLine = song->ticksPerLine();
+    mutex.unlock();
+}
+
+void Player::resetTrackVolumes()
+{
+    // The volumes are copied again when playing starts
+    if (mode_ != ModeIdle) {
+        return;
+    }
+
+    mutex.lock();
+    for (int track = 0; track < trackStatuses.count() && track < song->maxTracks(); track++) {
+        trackStatuses.trackVolume[track] = song->track(track)->volume();
+    }
+    mutex.unlock();
+}
+
+void Player::resetInstrumentVelocities()
+{
+    mutex.lock();
+
+    // Only instruments added while playing get their default velocities; the rest are copied again when playing starts
+    int firstInstrument = mode_ == ModeIdle ? 0 : qMin(instrumentVelocities.count(), (int)song->instruments());
+    instrumentVelocities.resize(song->instruments());
+    for (int instrument = firstInstrument; instrument < song->instruments(); instrument++) {
+        instrumentVelocities[instrument] = song->instrument(instrument)->defaultVelocity();
+    }
+
+    mutex.unlock();
+}
+
+MIDIInterface *Player::output(int midiInterface) const
+{
+    return midiInterface >= 0 && midiInterface < outputs.count() ? outputs.at(midiInterface) : outputs.at(0);
+}
+
+int Player::routeInterface(const Route &route, unsigned int track) const
+{
+    return exportOutputs == ExportOutputsPerTrack ? track + 1 : route.midiInterface;
+}
+
+void Player::setMidiControllerValue(int midiInterface, int index, unsigned char value)
+{
+    midiControllerValues[midiInterface][index] = value;
+    midiControllersSet[midiInterface].setBit(index);
+}
+
+Player::State Player::state() const
+{
+    State state;
+    state.section = section_;
+    state.position = position_;
+    state.line = line_;
+    state.tick = tick;
+    state.ticks = ticksSoFar;
+    state.tempo = tempo;
+    state.ticksPerLine = ticksPerLine;
+    state.trackStatuses = trackStatuses;
+    state.instrumentVelocities = instrumentVelocities;
+    state.midiControllerValues = midiControllerValues;
+    state.midiControllersSet = midiControllersSet;
+    return state;
+}
+
+void Player::restoreState(const State &state, bool sendChanges)
+{
+    stopNotes();
+
+    section_ = state.section;
+    position_ = state.position;
+    line_ = state.line;
+    updateLocation();
+
+    if (sendChanges && tempo != state.tempo) {
+        output(0)->tempo(state.tempo);
+    }
+    tempo = state.tempo;
+    ticksPerLine = state.ticksPerLine;
+    if (state.instrumentVelocities.count() == instrumentVelocities.count()) {
+        instrumentVelocities = state.instrumentVelocities;
+    }
+
+    // Notes played before the location are not continued
+    int tracks = trackStatuses.count();
+    trackStatuses = state.trackStatuses;
+    trackStatuses.resize(tracks);
+    for (int track = 0; track < tracks; track++) {
+        trackStatuses.note[track] = -1;
+        trackStatuses.hold[track] = -1;
+    }
+
+    // Values that were not set before the location are left as they are
+    for (int midiInterface = 0; midiInterface < midiControllerValues.count() && midiInterface < state.midiControllerValues.count(); midiInterface++) {
+        MIDIInterface *output = this->output(midiInterface);
+        const QBitArray &set = state.midiControllersSet.at(midiInterface);
+        const unsigned char *values = state.midiControllerValues.at(midiInterface).constData();
+        unsigned char *currentValues = midiControllerValues[midiInterface].data();
+
+        for (int index = 0; index < 16 * VALUES; index++) {
+            if (!set.testBit(index)) {
+                continue;
+            }
+
+            if (sendChanges && values[index] != currentValues[index]) {
+                int midiChannel = index / VALUES;
+                int value = index % VALUES;
+                if (value < 128) {
+                    output->controller(midiChannel, value, values[index]);
+                } else if (value == VALUES_CHANNEL_PRESSURE) {
+                    output->channelPressure(midiChannel, values[index]);
+                } else if (value == VALUES_PITCH_WHEEL) {
+                    output->pitchWheel(midiChannel, values[index]);
+                } else if (value == VALUES_PROGRAM) {
+                    output->programChange(midiChannel, values[index] - 1);
+                }
+            }
+            currentValues[index] = values[index];
+            midiControllersSet[midiInterface].setBit(index);
+        }
+    }
+}
+
+Player *Player::createSimulation() const
+{
+    Player *simulation = new Player(midi_, song, true);
+    simulation->exportOutputs = ExportOutputsNone;
+    simulation->init();
+    // Simulations run in their own threads on the snapshot taken by init() and must not follow the song being edited
+    disconnect(song, NULL, simulation, NULL);
+    simulation->mode_ = ModePlaySong;
+    simulation->killWhenLooped = true;
+    return simulation;
+}
+
+void Player::chase()
+{
+    // Start from the checkpoint of the current position if the checkpoints are up to date
+    const State *checkpoint = NULL;
+    if (checkpointGeneration == songGeneration) {
+        QHash<quint64, int>::const_iterator i = checkpointIndex.constFind(((quint64)section_ << 32) | position_);
+        if (i != checkpointIndex.constEnd() && checkpoints.at(i.value()).line <= line_) {
+            checkpoint = &checkpoints.at(i.value());
+        }
+    }
+
+    // Play silently to the current line; run() does it before playing so the caller doesn't wait for it
+    chaseTarget.section = section_;
+    chaseTarget.position = position_;
+    chaseTarget.line = line_;
+    chaseSimulation = createSimulation();
+    if (checkpoint != NULL) {
+        chaseSimulation->restoreState(*checkpoint, false);
+    }
+    chaseSimulation->chaseState = &chaseTarget;
+}
+
+bool Player::finishChase()
+{
+    chaseSimulation->run();
+
+    mutex.lock();
+    Player *simulation = chaseSimulation;
+    chaseSimulation = NULL;
+    bool reached = simulation->chaseReached && !killThread;
+    if (reached) {
+        restoreState(chaseTarget, true);
+    }
+    bool killed = killThread;
+    mutex.unlock();
+
+    // The simulation was created in the thread that started playing
+    simulation->deleteLater();
+
+    return !killed;
+}
+
+bool Player::locate(unsigned int ticks, State &target)
+{
+    // Start from the last checkpoint before the position if the checkpoints are up to date; they are in playing order
+    const State *checkpoint = NULL;
+    if (checkpointGeneration == songGeneration) {
+        int first = 0, last = checkpoints.count();
+        while (first < last) {
+            int middle = (first + last) / 2;
+            if (checkpoints.at(middle).ticks <= ticks) {
+                first = middle + 1;
+            } else {
+                last = middle;
+            }
+        }
+        if (first > 0) {
+            checkpoint = &checkpoints.at(first - 1);
+        }
+    }
+
+    // Play silently to the given tick
+    Player *simulation = createSimulation();
+    if (checkpoint != NULL) {
+        simulation->restoreState(*checkpoint, false);
+        simulation->ticksSoFar = checkpoint->ticks;
+    }
+    simulation->chaseState = &target;
+    simulation->chaseTicks = ticks;
+    simulation->run();
+    bool reached = simulation->chaseReached;
+    delete simulation;
+
+    return reached;
+}
+
+void Player::setSongPosition(unsigned int position)
+{
+    if (song == NULL || from_export) {
+        return;
+    }
+
+    // Relocating while playing continues from the new position
+    bool playing = mode_ != ModeIdle;
+    if (playing) {
+        stop();
+    }
+
+    // Six MIDI clocks, and thus ticks, per sixteenth note
+    State target;
+    if (locate(position * 6, target)) {
+        unsigned int oldLine = line_;
+
+        // Send the controller values, programs and tempo right away so the devices are ready before the next clock
+        resetPlaybackState();
+        restoreState(target, true);
+        songPosition = target;
+        songPositionLocated = true;
+
+        if (line_ != oldLine) {
+            emit lineChanged(line_);
+        }
+    }
+
+    if (playing) {
+        play(ModePlaySong, true);
+    }
+}
+
+void Player::invalidateCheckpoints()
+{
+    if (from_export) {
+        return;
+    }
+
+    songGeneration++;
+    checkpointTimer.start();
+}
+
+void Player::buildCheckpoints()
+{
+    stopCheckpointBuilder();
+
+    if (song == NULL) {
+        return;
+    }
+
+    checkpointBuilder = createSimulation();
+    checkpointBuilder->recordCheckpoints = true;
+    checkpointBuilder->checkpointGeneration = songGeneration;
+    connect(checkpointBuilder, SIGNAL(finished()), this, SLOT(checkpointsBuilt()));
+    checkpointBuilder->start(QThread::LowestPriority);
+}
+
+void Player::checkpointsBuilt()
+{
+    // Ignore builders that have been stopped already
+    if (checkpointBuilder == NULL || sender() != checkpointBuilder) {
+        return;
+    }
+
+    checkpointBuilder->wait();
+    if (checkpointBuilder->checkpointGeneration == songGeneration) {
+        checkpoints = checkpointBuilder->checkpoints;
+        checkpointIndex = checkpointBuilder->checkpointIndex;
+        checkpointGeneration = songGeneration;
+    }
+
+    delete checkpointBuilder;
+    checkpointBuilder = NULL;
+}
+
+void Player::stopCheckpointBuilder()
+{
+    if (checkpointBuilder != NULL) {
+        checkpointBuilder->mutex.lock();
+        checkpointBuilder->killThread = true;
+        checkpointBuilder->mutex.unlock();
+        checkpointBuilder->wait();
+
+        delete checkpointBuilder;
+        checkpointBuilder = NULL;
+    }
+}
+
+void Player::startSchedule()
+{
+    midi()->startSchedule();
+    scheduleBase = 0;
+    scheduleTicks = 0;
+    scheduleTempo = tempo;
+}
+
+qint64 Player::scheduleTick()
+{
+    // Continue from the previous tick at a new tempo
+    if (tempo != scheduleTempo) {
+        scheduleBase += Scheduler::tickTime(scheduleTicks, scheduleTempo);
+        scheduleTicks = 0;
+        scheduleTempo = tempo;
+    }
+
+    // Calculated like the deadlines of the monotonic scheduler so the ticks are delivered exactly one lookahead after them
+    scheduleTicks++;
+    return scheduleBase + Scheduler::tickTime(scheduleTicks, tempo) + (qint64)midi()->lookahead() * 1000000;
+}
+
+void Player::discardSchedule()
+{
+    // The player thread itself only moves forward
+    if (scheduling && isRunning() && QThread::currentThread() != this) {
+        midi()->discardSchedule();
     }
 }
 
@@ -1269,12 +1919,28 @@ void Player::unlock()
 }
 
 void Player::externalSync(unsigned int ticks)
+{
+    receiveClocks(ticks, ClockFollower::currentTime());
+}
+
+void Player::receiveClock(qint64 time)
+{
+    receiveClocks(1, time);
+}
+
+void Player::receiveClocks(unsigned int ticks, qint64 time)
 {
     mutex.lock();
     if (mode_ != ModeIdle) {
         externalSyncTicks += ticks;
+        for (unsigned int clock = 0; clock < ticks; clock++) {
+            clockFollower.clock(time);
+        }
     }
     externalSync_.wakeAll();
+    if (scheduler != NULL) {
+        scheduler->wake();
+    }
     mutex.unlock();
 }
 
@@ -1284,6 +1950,9 @@ void Player::setExternalSync(ExternalSync externalSync)
 
     syncMode = externalSync;
 
+    // Clock messages are dropped as soon as they are read when not synced to them
+    midi_->setClockEnabled(syncMode != Off);
+
     if (syncMode == Off && prevsyncMode != Off) {
         this->externalSync(0);
     }
@@ -1291,6 +1960,10 @@ void Player::setExternalSync(ExternalSync externalSync)
 
 void Player::setScheduler(Scheduler *scheduler)
 {
+    if (scheduler != NULL) {
+        scheduler->setMidi(midi_);
+    }
+
     this->scheduler = scheduler;
 }
 
@@ -1334,20 +2007,99 @@ MIDI *Player::midi() const
     return midi_;
 }
 
-Player::TrackStatus::TrackStatus(unsigned int track) :
-    track(track)
+unsigned int Player::ticksPlayed() const
+{
+    return ticksSoFar;
+}
+
+bool Player::playedTick(qint64 time, PlayedTick &playedTick) const
 {
-    reset();
+    bool found = false;
+
+    // Go back from the latest tick to the one that started before the time
+    playedTicksMutex.lock();
+    unsigned int oldest = playedTickCount > PLAYED_TICKS ? playedTickCount - PLAYED_TICKS : 0;
+    for (unsigned int index = playedTickCount; index > oldest && !found; index--) {
+        const PlayedTick &candidate = playedTicks.at((index - 1) % PLAYED_TICKS);
+        if (candidate.time <= time) {
+            playedTick = candidate;
+            found = true;
+        }
+    }
+    playedTicksMutex.unlock();
+
+    return found;
+}
+
+void Player::recordPlayedTick()
+{
+    // With a lookahead the tick is heard later than it is handled
+    qint64 time = ClockFollower::currentTime();
+    if (scheduling && syncMode == Off) {
+        time += (qint64)midi()->lookahead() * 1000000;
+    }
+
+    // Playing a block repeats it; a song continues from the next position
+    unsigned int nextBlock = block_;
+    if (mode_ == ModePlaySong) {
+        unsigned int section = section_;
+        unsigned int position = position_ + 1;
+        if (position >= snapshot->playseqs.at(playseq_).count()) {
+            section = section_ + 1 < snapshot->sections.count() ? section_ + 1 : 0;
+            position = 0;
+        }
+        nextBlock = snapshot->playseqs.at(snapshot->sections.at(section)).at(position);
+    }
+
+    playedTicksMutex.lock();
+    if (playedTicks.isEmpty()) {
+        playedTicks.resize(PLAYED_TICKS);
+    }
+    PlayedTick &playedTick = playedTicks[playedTickCount % PLAYED_TICKS];
+    playedTick.time = time;
+    playedTick.block = block_;
+    playedTick.nextBlock = nextBlock;
+    playedTick.line = line_;
+    playedTick.tick = tick;
+    playedTick.ticksPerLine = ticksPerLine;
+    playedTick.ticks = ticksSoFar;
+    playedTickCount++;
+    playedTicksMutex.unlock();
+}
+
+int Player::TrackStatuses::count() const
+{
+    return note.count();
+}
+
+void Player::TrackStatuses::resize(int tracks)
+{
+    int oldTracks = count();
+
+    baseNote.resize(tracks);
+    instrument.resize(tracks);
+    line.resize(tracks);
+    previousCommand.resize(tracks);
+    midiInterface.resize(tracks);
+    midiChannel.resize(tracks);
+    volume.resize(tracks);
+    note.resize(tracks);
+    hold.resize(tracks);
+    trackVolume.resize(tracks);
+
+    for (int track = oldTracks; track < tracks; track++) {
+        reset(track);
+    }
 }
 
-void Player::TrackStatus::reset()
+void Player::TrackStatuses::reset(int track)
 {
-    instrument = -1;
-    line = -1;
-    previousCommand = 0;
-    note = -1;
-    midiChannel = -1;
-    midiInterface = -1;
-    volume = -1;
-    hold = -1;
+    instrument[track] = -1;
+    line[track] = -1;
+    previousCommand[track] = 0;
+    note[track] = -1;
+    midiChannel[track] = -1;
+    midiInterface[track] = -1;
+    volume[track] = -1;
+    hold[track] = -1;
 }
@@ -27,36 +27,66 @@
 #include <QMutex>
 #include <QWaitCondition>
 #include <QVector>
+#include <QBitArray>
+#include <QHash>
+#include <QSet>
+#include <QTimer>
 #include <QSharedPointer>
+#include "clockfollower.h"
 
 class Song;
+class SongSnapshot;
 class Block;
 class Track;
 class MIDI;
+class MIDIInterface;
 class Scheduler;
 
 class Player : public QThread {
     Q_OBJECT
 
-    // Track status values
-    class TrackStatus {
+    // Track status values; one array per value so that loops over the tracks access contiguous memory
+    class TrackStatuses {
     public:
-        TrackStatus(unsigned int track);
-        void reset();
-
-    private:
-        unsigned int track;
-        char baseNote;
-        char instrument;
-        char line;
-        char previousCommand;
-        char midiInterface;
-        char midiChannel;
-        char volume;
-        char note;
-        int hold;
+        // Returns the number of tracks
+        int count() const;
+        // Sets the number of tracks; added tracks are reset
+        void resize(int tracks);
+        // Resets the status of a track
+        void reset(int track);
+
+        QVector<char> baseNote;
+        QVector<char> instrument;
+        QVector<char> line;
+        QVector<char> previousCommand;
+        QVector<char> midiInterface;
+        QVector<char> midiChannel;
+        QVector<char> volume;
+        QVector<char> note;
+        QVector<int> hold;
+        // Track volumes while playing; not affected by reset()
+        QVector<unsigned char> trackVolume;
+    };
 
-        friend class Player;
+    // Playback state set up by the lines played before a location in the song
+    class State {
+    public:
+        unsigned int section, position, line;
+        // Ticks played of the line and since the beginning of the song
+        unsigned int tick, ticks;
+        unsigned int tempo, ticksPerLine;
+        TrackStatuses trackStatuses;
+        QVector<unsigned char> instrumentVelocities;
+        QList<QVector<unsigned char> > midiControllerValues;
+        QList<QBitArray> midiControllersSet;
+    };
+
+    // The MIDI interface and channel an instrument plays on
+    class Route {
+    public:
+        Route(int midiInterface = -1, char midiChannel = -1) { this->midiInterface = midiInterface; this->midiChannel = midiChannel; }
+        int midiInterface;
+        char midiChannel;
     };
 
     class NoteOn {
@@ -101,8 +131,29 @@ public:
         Midi
     };
 
+    // MIDI outputs used when playing without scheduling (none when simulating); output 0 always gets events not tied to a track or an instrument
+    enum ExportOutputs {
+        ExportOutputsNone,
+        ExportOutputsSingle,
+        ExportOutputsPerTrack,
+        ExportOutputsPerInstrument
+    };
+
+    // A tick that has been played and when it was heard
+    class PlayedTick {
+    public:
+        // CLOCK_MONOTONIC time in nanoseconds
+        qint64 time;
+        unsigned int block, line, tick, ticksPerLine;
+        // Block played after this one
+        unsigned int nextBlock;
+        // Ticks played since playing started
+        unsigned int ticks;
+    };
+
     // Creates a player
     Player(MIDI *midi, const QString &path = QString(), QObject *parent = NULL);
+    // Creates a player for exporting a song; init() must be invoked before playing
     Player(MIDI *midi, Song *song, bool from_export, QObject *parent = NULL);
     // Closes a player
     virtual ~Player();
@@ -115,7 +166,13 @@ public:
     Mode mode() const;
 
     // Plays a song without any scheduling (for export)
-    void playWithoutScheduling();
+    void playWithoutScheduling(ExportOutputs exportOutputs = ExportOutputsSingle);
+
+    // Returns the number of ticks played since playing started
+    unsigned int ticksPlayed() const;
+
+    // Finds the tick that was being heard at the given CLOCK_MONOTONIC time; returns false if not known
+    bool playedTick(qint64 time, PlayedTick &playedTick) const;
 
     // Plays a note using given instrument on a given channel
     void playNote(unsigned int instrumentNumber, unsigned char note, unsigned char volume, unsigned char track, bool postpone = false);
@@ -124,7 +181,7 @@ public:
     // Stops notes playing at the moment
     void stopNotes();
     // Handles a command
-    void handleCommand(QSharedPointer<TrackStatus>, unsigned char, unsigned char, unsigned char, unsigned char, unsigned int *, int *, int *, int *);
+    void handleCommand(unsigned int, unsigned char, unsigned char, unsigned char, unsigned char, unsigned int *, int *, int *, int *);
     // Resets the player time
     void resetTime(bool);
 
@@ -159,6 +216,8 @@ public slots:
     void setSong(const QString &path = QString());
     // A method to notify the player about an incoming sync signal
     void externalSync(unsigned int ticks = 1);
+    // Notifies the player about a clock message received at the given CLOCK_MONOTONIC time
+    void receiveClock(qint64 time);
 
     // Set player position
     void setSection(int);
@@ -167,6 +226,9 @@ public slots:
     void setBlock(int);
     void setLine(int line, bool wrap = true);
 
+    // Moves to a MIDI song position given in sixteenth notes and restores the playback state there
+    void setSongPosition(unsigned int position);
+
 private slots:
     // Initializes the player
     void init();
@@ -177,6 +239,12 @@ private slots:
     // Refreshes playseq from section and block from position
     void updateLocation(bool alwaysSendLocationSignals = false);
 
+    // Plays a note as the given version of the song has it; the mutex must be held
+    void playNote(const SongSnapshot &snapshot, unsigned int instrumentNumber, unsigned char note, unsigned char volume, unsigned char track, bool postpone);
+
+    // Remembers the current location; returns false if it has been visited already
+    bool visitLocation();
+
     // Resets the section number ensuring that the playing sequence currently exists
     void resetSection();
 
@@ -192,8 +260,32 @@ private slots:
     // Notifies the player that MIDI interfaces have changed
     void remapMidiOutputs();
 
-    // Checks whether some tracks are soloed or not
-    void checkSolo();
+    // Rebuilds the instrument routes and the output lists
+    void updateRouting();
+
+    // Copies the tempo, ticks per line and volumes that commands may change from the song
+    void resetPlaybackState();
+
+    // Copies the tempo from the song
+    void resetTempo();
+
+    // Copies the ticks per line from the song
+    void resetTicksPerLine();
+
+    // Copies the track volumes from the song unless commands may have changed them while playing
+    void resetTrackVolumes();
+
+    // Copies the instrument velocities from the song unless commands may have changed them while playing
+    void resetInstrumentVelocities();
+
+    // Marks the checkpoints out of date and schedules rebuilding them
+    void invalidateCheckpoints();
+
+    // Starts building checkpoints in the background
+    void buildCheckpoints();
+
+    // Takes the checkpoints built in the background into use
+    void checkpointsBuilt();
 
 signals:
     void songChanged(Song *song);
@@ -209,14 +301,23 @@ protected:
     virtual void run();
 
 private:
-    // 128 MIDI controllers plus aftertouch, channel pressure and pitch wheel
+    // 128 MIDI controllers plus aftertouch, channel pressure, pitch wheel and program (plus one, 0 if not known)
     enum Values {
-      VALUES = (128 + 3),
+      VALUES = (128 + 4),
       VALUES_AFTERTOUCH = 128,
       VALUES_CHANNEL_PRESSURE = 129,
-      VALUES_PITCH_WHEEL = 130
+      VALUES_PITCH_WHEEL = 130,
+      VALUES_PROGRAM = 131
     };
 
+    // Number of recently played ticks remembered for mapping input to locations
+    enum {
+        PLAYED_TICKS = 1024
+    };
+
+    // Remembers when the current tick will be heard
+    void recordPlayedTick();
+
     // Starts the player thread
     void play(Mode, bool);
 
@@ -226,10 +327,56 @@ private:
     // Advances in playing sequence and jumps to next section if necessary
     bool nextPosition();
 
+    // Returns the output of a MIDI interface number or the null output if the interface is not known
+    MIDIInterface *output(int midiInterface) const;
+
+    // Returns the MIDI interface number a track playing an instrument route sends to
+    int routeInterface(const Route &route, unsigned int track) const;
+
+    // Stores the value of a MIDI controller, aftertouch, channel pressure, pitch wheel or program
+    void setMidiControllerValue(int midiInterface, int index, unsigned char value);
+
+    // Returns the current playback state
+    State state() const;
+
+    // Restores a playback state; optionally sends the controller values that differ from the current ones
+    void restoreState(const State &state, bool sendChanges);
+
+    // Creates a player that plays the song silently to find out the playback state at a location
+    Player *createSimulation() const;
+
+    // Counts incoming sync signals and feeds their arrival time to the clock follower
+    void receiveClocks(unsigned int ticks, qint64 time);
+
+    // Prepares bringing the playback state and the MIDI devices to what playing from the beginning would have produced
+    void chase();
+
+    // Runs the chase prepared by chase() in the player thread; returns false if playing was stopped meanwhile
+    bool finishChase();
+
+    // Finds out the playback state after the given number of ticks from the beginning of the song; returns false if the song ends before
+    bool locate(unsigned int ticks, State &target);
+
+    // Stops and deletes the player building checkpoints
+    void stopCheckpointBuilder();
+
+    // Starts a new timeline for the delivery times of scheduled messages
+    void startSchedule();
+
+    // Advances the delivery timeline by a tick and returns the delivery time of the tick
+    qint64 scheduleTick();
+
+    // Drops the scheduled messages not delivered yet when the location changes during playback
+    void discardSchedule();
+
     // Current location in song
     unsigned int section_, playseq_, position_, block_, line_, tick;
+    // Tempo and ticks per line while playing; commands change these instead of the song
+    unsigned int tempo, ticksPerLine;
     // The song currently being played
     Song *song;
+    // The version of the song structure currently being played
+    QSharedPointer<const SongSnapshot> snapshot;
     // The previous song being destroyed
     Song *oldSong;
     // Player mode
@@ -237,26 +384,47 @@ private:
     // Player scheduling mode
     Scheduler *scheduler;
     ExternalSync syncMode;
+    // Whether messages are rendered ahead and delivered by the MIDI backend at their tick times
+    bool scheduling;
+    // Delivery timeline of scheduled messages: when the current tempo took effect, ticks since then and the tempo
+    qint64 scheduleBase, scheduleTicks;
+    unsigned int scheduleTempo;
     // Status of tracks; notes playing
-    QList<QSharedPointer<TrackStatus> > trackStatuses;
+    TrackStatuses trackStatuses;
     // MIDI controller values; one for each controller on each channel
     QList<QVector<unsigned char> > midiControllerValues;
+    // Whether each MIDI controller value has been set
+    QList<QBitArray> midiControllersSet;
     // For measuring how long the song has been playing
     struct timeval playingStarted, playedSoFar;
     // Ticks passed after playing started
     unsigned int ticksSoFar;
+    // Recently played ticks in a ring and the number of ticks recorded since playing started
+    QVector<PlayedTick> playedTicks;
+    unsigned int playedTickCount;
+    mutable QMutex playedTicksMutex;
     // Mutex for the player thread
     QMutex mutex;
     // Cond for external sync
     QWaitCondition externalSync_;
     // External sync tick count
     int externalSyncTicks;
+    // Recovers the timing of the external clock (the mutex must be used when accessing)
+    ClockFollower clockFollower;
     // Kill player flag (the mutex must be used when accessing)
     bool killThread;
     // MIDI subsystem
     MIDI *midi_;
-    // Indicates whether some tracks are soloed or not
-    unsigned int solo;
+    // References to the MIDI outputs keeping the raw pointers below valid
+    QList<QSharedPointer<MIDIInterface> > outputReferences;
+    // MIDI outputs by interface number
+    QVector<MIDIInterface *> outputs;
+    // Enabled MIDI outputs; only these need per tick processing
+    QVector<MIDIInterface *> activeOutputs;
+    // MIDI interface and channel of each instrument
+    QVector<Route> routes;
+    // Default velocities of instruments while playing; commands change these instead of the song
+    QVector<unsigned char> instrumentVelocities;
     // The command to be executed after the current line
     unsigned char postCommand, postValue;
     // Indicates whether the tempo has changed
@@ -265,8 +433,38 @@ private:
     QList<NoteOn> postponedNotes;
     // Whether the player should quit when the song loops
     bool killWhenLooped;
+    // Section, position and line of each block change since playing started when quitting when the song loops;
+    // a jump back to any of them would repeat the same part of the song forever
+    QSet<quint64> visitedLocations;
     //
     bool from_export;
+    // MIDI outputs used when exporting
+    ExportOutputs exportOutputs;
+    // Playback state at the beginning of each position of the song, indexed by section and position
+    QList<State> checkpoints;
+    QHash<quint64, int> checkpointIndex;
+    // Whether run() records checkpoints
+    bool recordCheckpoints;
+    // Location where run() stores the state and stops; NULL if not chasing
+    State *chaseState;
+    // If not negative run() stops at this tick count instead of the chase location
+    qint64 chaseTicks;
+    // Whether the chase location was reached
+    bool chaseReached;
+    // The player chasing the location playing continues from and the location; NULL when not chasing
+    Player *chaseSimulation;
+    State chaseTarget;
+    // Incremented whenever the song changes; checkpoints are up to date if built for the current generation
+    unsigned int songGeneration, checkpointGeneration;
+    // State located from a song position; used instead of chasing when continuing from there
+    State songPosition;
+    bool songPositionLocated;
+    // The player building checkpoints in the background
+    Player *checkpointBuilder;
+    // Delays rebuilding checkpoints until the song has not changed for a while
+    QTimer checkpointTimer;
+    // Disabled output used when simulating
+    QSharedPointer<MIDIInterface> silentOutput;
 };
 
 #endif // PLAYER_H_
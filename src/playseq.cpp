@@ -54,6 +54,11 @@ unsigned int Playseq::at(unsigned int pos) const
     return blockNumbers[pos < blockNumbers.count() ? pos : (blockNumbers.count() - 1)];
 }
 
+QList<unsigned int> Playseq::blockList() const
+{
+    return blockNumbers;
+}
+
 void Playseq::set(unsigned int pos, unsigned int block)
 {
     blockNumbers[pos < blockNumbers.count() ? pos : (blockNumbers.count() - 1)] = block;
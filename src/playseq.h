@@ -49,6 +49,9 @@ public:
     // Returns the block at the given position
     unsigned int at(unsigned int pos) const;
 
+    // Returns the blocks of the playing sequence
+    QList<unsigned int> blockList() const;
+
     // Sets the block at the given position
     void set(unsigned int pos, unsigned int block);
 
@@ -22,6 +22,7 @@
 
 #include "player.h"
 #include "scheduler.h"
+#include "schedulercalibration.h"
 #include "midi.h"
 #include "midiinterface.h"
 #include "outputmidiinterfacestablemodel.h"
@@ -51,11 +52,26 @@ PreferencesDialog::PreferencesDialog(Player *player, QWidget *parent) :
         ui->comboBoxSchedulingMode->insertItem(index, tr(scheduler->name()));
         schedulers.insert(index++, scheduler);
     }
-    setSchedulingMode(settings.value("schedulingMode").toString());
+    setSchedulingMode(settings.value("schedulingMode", SchedulerCalibration::best()->name()).toString());
+
+    // Only backends that can deliver messages at given times support a lookahead
+    ui->spinBoxLookahead->setEnabled(player->midi()->canSchedule());
+    ui->spinBoxLookahead->setValue(settings.value("MIDI/lookahead", 0).toInt());
+    player->midi()->setLookahead(ui->spinBoxLookahead->value());
+    ui->spinBoxInputLatency->setValue(settings.value("MIDI/inputLatency", 0).toInt());
+    player->midi()->setInputLatency(ui->spinBoxInputLatency->value());
 
     connect(player->midi(), SIGNAL(outputsChanged()), this, SLOT(enableInterfaces()));
     connect(player->midi(), SIGNAL(inputsChanged()), this, SLOT(enableInterfaces()));
     connect(ui->comboBoxSchedulingMode, SIGNAL(currentIndexChanged(int)), this, SLOT(setScheduler(int)));
+    connect(ui->spinBoxLookahead, SIGNAL(valueChanged(int)), this, SLOT(setLookahead(int)));
+    connect(ui->spinBoxInputLatency, SIGNAL(valueChanged(int)), this, SLOT(setInputLatency(int)));
+
+    // Show the timing statistics of the scheduler while the dialog is open
+    statisticsTimer.setInterval(1000);
+    connect(&statisticsTimer, SIGNAL(timeout()), this, SLOT(updateStatistics()));
+    statisticsTimer.start();
+    updateStatistics();
 }
 
 PreferencesDialog::~PreferencesDialog()
@@ -66,6 +82,7 @@ PreferencesDialog::~PreferencesDialog()
 void PreferencesDialog::makeVisible()
 {
     show();
+    updateStatistics();
     raise();
     activateWindow();
 }
@@ -93,6 +110,31 @@ void PreferencesDialog::setScheduler(int index)
     settings.setValue("schedulingMode", scheduler->name());
 }
 
+void PreferencesDialog::setLookahead(int lookahead)
+{
+    player->midi()->setLookahead(lookahead);
+    settings.setValue("MIDI/lookahead", lookahead);
+}
+
+void PreferencesDialog::setInputLatency(int inputLatency)
+{
+    player->midi()->setInputLatency(inputLatency);
+    settings.setValue("MIDI/inputLatency", inputLatency);
+}
+
+void PreferencesDialog::updateStatistics()
+{
+    if (!isVisible()) {
+        return;
+    }
+
+    Scheduler *scheduler = schedulers.value(ui->comboBoxSchedulingMode->currentIndex());
+    if (scheduler != NULL) {
+        ui->labelLateness->setText(scheduler->lateness().summary());
+        ui->labelProcessing->setText(scheduler->processing().summary());
+    }
+}
+
 void PreferencesDialog::enableInterfaces()
 {
     MIDI *midi = player->midi();
@@ -26,6 +26,7 @@
 #include "tutkadialog.h"
 #include <QSettings>
 #include <QHash>
+#include <QTimer>
 
 namespace Ui {
     class PreferencesDialog;
@@ -50,6 +51,9 @@ public slots:
 private slots:
     void setSchedulingMode(const QString &name);
     void setScheduler(int index);
+    void setLookahead(int lookahead);
+    void setInputLatency(int inputLatency);
+    void updateStatistics();
     void enableInterfaces();
     void saveSettings();
 
@@ -60,6 +64,7 @@ private:
     OutputMidiInterfacesTableModel *outputMidiInterfacesTableModel;
     InputMidiInterfacesTableModel *inputMidiInterfacesTableModel;
     QHash<int, Scheduler *> schedulers;
+    QTimer statisticsTimer;
 };
 
 #endif // PREFERENCESDIALOG_H
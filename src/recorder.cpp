@@ -0,0 +1,208 @@
+/*
+ * recorder.cpp
+ *
+ * Copyright 2002-2019 Vesa Halttunen
+ *
+ * This file is part of Tutka.
+ *
+ * Tutka is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tutka is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tutka; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "song.h"
+#include "block.h"
+#include "midi.h"
+#include "recorder.h"
+
+Recorder::Recorder(Player *player, QObject *parent) :
+    QObject(parent),
+    player(player),
+    quantize(true),
+    recordControllers(false)
+{
+}
+
+void Recorder::record(const QVector<MIDIInputEvent> &events, Song *song, int track, int instrument, int commandPage)
+{
+    if (song == NULL) {
+        return;
+    }
+
+    qint64 latency = (qint64)player->midi()->inputLatency() * 1000000;
+
+    // The player sees the messages recorded together in one snapshot
+    song->beginUpdate();
+    for (int event = 0; event < events.count(); event++) {
+        const MIDIMessage &message = events.at(event).message;
+        if (message.length() != MIDIMessage::MAXIMUM_LENGTH) {
+            continue;
+        }
+
+        // Find out what was being heard when the message was played
+        Player::PlayedTick playedTick;
+        if (!player->playedTick(events.at(event).time - latency, playedTick) || playedTick.block >= song->blocks()) {
+            continue;
+        }
+
+        const unsigned char *data = message.data();
+        switch (data[0] & 0xf0) {
+        case 0x90:
+            // Note on with zero velocity is a note off
+            if (data[2] > 0) {
+                noteOn(song, playedTick, data[1], data[2], track, instrument, commandPage);
+            } else {
+                noteOff(song, playedTick, data[1], commandPage);
+            }
+            break;
+        case 0x80:
+            noteOff(song, playedTick, data[1], commandPage);
+            break;
+        case 0xb0:
+            if (recordControllers) {
+                unsigned int block, delay;
+                unsigned int line = this->line(song, playedTick, block, delay);
+                song->block(block)->setCommandFull(line, track, commandPage, Player::CommandMidiControllers + data[1], data[2]);
+            }
+            break;
+        case 0xe0:
+            if (recordControllers) {
+                unsigned int block, delay;
+                unsigned int line = this->line(song, playedTick, block, delay);
+                song->block(block)->setCommandFull(line, track, commandPage, Player::CommandPitchWheel, data[2]);
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    song->endUpdate();
+}
+
+void Recorder::setQuantize(bool quantize)
+{
+    this->quantize = quantize;
+}
+
+void Recorder::setRecordControllers(bool recordControllers)
+{
+    this->recordControllers = recordControllers;
+}
+
+void Recorder::reset()
+{
+    heldNotes.clear();
+}
+
+void Recorder::noteOn(Song *song, const Player::PlayedTick &playedTick, unsigned char note, unsigned char velocity, int track, int instrument, int commandPage)
+{
+    unsigned int blockNumber, delay;
+    unsigned int line = this->line(song, playedTick, blockNumber, delay);
+    Block *block = song->block(blockNumber);
+
+    // A note retriggered before its release ends the earlier one
+    noteOff(song, playedTick, note, commandPage);
+
+    // The velocity goes to the current command page, the length to the next one and the delay to the one after that
+    int recordTrack = freeTrack(blockNumber, block->tracks(), track);
+    ensureCommandPages(block, commandPage + (delay > 0 ? 3 : 2));
+    block->setNoteFull(line, recordTrack, note + 1, instrument);
+    block->setCommandFull(line, recordTrack, commandPage, Player::CommandVelocity, velocity);
+    block->setCommandFull(line, recordTrack, commandPage + 1, 0, 0);
+    if (delay > 0) {
+        block->setCommandFull(line, recordTrack, commandPage + 2, Player::CommandDelay, delay);
+    } else if ((int)block->commandPages() > commandPage + 2) {
+        block->setCommandFull(line, recordTrack, commandPage + 2, 0, 0);
+    }
+
+    HeldNote heldNote;
+    heldNote.block = blockNumber;
+    heldNote.line = line;
+    heldNote.track = recordTrack;
+    heldNote.ticks = playedTick.ticks;
+    heldNotes.insert(note, heldNote);
+}
+
+void Recorder::noteOff(Song *song, const Player::PlayedTick &playedTick, unsigned char note, int commandPage)
+{
+    if (!heldNotes.contains(note)) {
+        return;
+    }
+
+    HeldNote heldNote = heldNotes.take(note);
+
+    // Playing may have been restarted in between
+    if (heldNote.block >= song->blocks() || playedTick.ticks < heldNote.ticks) {
+        return;
+    }
+
+    Block *block = song->block(heldNote.block);
+    if (heldNote.line >= block->length() || heldNote.track >= block->tracks()) {
+        return;
+    }
+
+    ensureCommandPages(block, commandPage + 2);
+    block->setCommandFull(heldNote.line, heldNote.track, commandPage + 1, Player::CommandHold, qBound(1u, playedTick.ticks - heldNote.ticks, 255u));
+}
+
+unsigned int Recorder::line(Song *song, const Player::PlayedTick &playedTick, unsigned int &block, unsigned int &delay) const
+{
+    block = playedTick.block;
+    unsigned int length = song->block(block)->length();
+    unsigned int line = playedTick.line < length ? playedTick.line : length - 1;
+    delay = playedTick.tick;
+
+    // Ticks in the latter half of a line belong to the next one when quantizing
+    if (quantize) {
+        if (delay * 2 >= playedTick.ticksPerLine) {
+            if (line + 1 < length) {
+                line++;
+            } else if (playedTick.nextBlock < song->blocks()) {
+                // The next line is the first line of the block played next
+                block = playedTick.nextBlock;
+                line = 0;
+            }
+        }
+        delay = 0;
+    }
+
+    return line;
+}
+
+int Recorder::freeTrack(unsigned int block, int tracks, int track) const
+{
+    for (int offset = 0; offset < tracks; offset++) {
+        int candidate = (track + offset) % tracks;
+        bool free = true;
+
+        foreach (const HeldNote &heldNote, heldNotes) {
+            if (heldNote.block == block && heldNote.track == (unsigned int)candidate) {
+                free = false;
+            }
+        }
+
+        if (free) {
+            return candidate;
+        }
+    }
+
+    // All tracks have a note held; replace the one on the first track
+    return track;
+}
+
+void Recorder::ensureCommandPages(Block *block, int commandPages)
+{
+    if ((int)block->commandPages() < commandPages) {
+        block->setCommandPages(commandPages);
+    }
+}
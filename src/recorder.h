@@ -0,0 +1,87 @@
+/*
+ * recorder.h
+ *
+ * Copyright 2002-2019 Vesa Halttunen
+ *
+ * This file is part of Tutka.
+ *
+ * Tutka is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tutka is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tutka; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef RECORDER_H_
+#define RECORDER_H_
+
+#include <QObject>
+#include <QHash>
+#include <QVector>
+#include "midiinputqueue.h"
+#include "player.h"
+
+class Song;
+class Block;
+
+// Records MIDI input to the blocks while the song is playing. Each message
+// is written to the line that was being heard when it was played, taking
+// the input latency into account. Notes held at the same time are spread
+// to free tracks and their lengths are recorded as hold commands.
+class Recorder : public QObject {
+    Q_OBJECT
+
+public:
+    explicit Recorder(Player *player, QObject *parent = NULL);
+
+    // Records received messages to the song; chords start from the given track, commands go to the given command page
+    void record(const QVector<MIDIInputEvent> &events, Song *song, int track, int instrument, int commandPage);
+
+public slots:
+    // Sets whether notes are moved to the nearest line or recorded with a delay command
+    void setQuantize(bool quantize);
+
+    // Sets whether controller and pitch wheel changes are recorded
+    void setRecordControllers(bool recordControllers);
+
+    // Forgets the notes being held
+    void reset();
+
+private:
+    // A note that has been recorded and not released yet
+    class HeldNote {
+    public:
+        unsigned int block, line, track, ticks;
+    };
+
+    // Records a note on at a played tick
+    void noteOn(Song *song, const Player::PlayedTick &playedTick, unsigned char note, unsigned char velocity, int track, int instrument, int commandPage);
+
+    // Records the length of a released note
+    void noteOff(Song *song, const Player::PlayedTick &playedTick, unsigned char note, int commandPage);
+
+    // Returns the line a played tick is recorded to, the block of the line and the delay of the tick within the line
+    unsigned int line(Song *song, const Player::PlayedTick &playedTick, unsigned int &block, unsigned int &delay) const;
+
+    // Returns the first track starting from the given one without a held note
+    int freeTrack(unsigned int block, int tracks, int track) const;
+
+    // Makes sure the block has at least the given number of command pages
+    static void ensureCommandPages(Block *block, int commandPages);
+
+    Player *player;
+    bool quantize;
+    bool recordControllers;
+    // Held notes by note number
+    QHash<int, HeldNote> heldNotes;
+};
+
+#endif // RECORDER_H_
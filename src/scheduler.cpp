@@ -21,13 +21,14 @@
  */
 
 #include <sys/time.h>
-#include "song.h"
+#include <QVariant>
 #include "scheduler.h"
 
 QList<Scheduler *> Scheduler::schedulers_;
 
 Scheduler::Scheduler(QObject *parent) :
-    QObject(parent)
+    QObject(parent),
+    midi(NULL)
 {
 }
 
@@ -39,9 +40,13 @@ void Scheduler::start(struct timeval &startTime)
 {
     next.tv_sec = startTime.tv_sec;
     next.tv_usec = startTime.tv_usec;
+
+    lateness_.reset();
+    processing_.reset();
+    wakeUpTimer.invalidate();
 }
 
-void Scheduler::waitForTick(Song *song, bool schedulerChanged)
+void Scheduler::waitForTick(unsigned int tempo, bool schedulerChanged)
 {
     // If the scheduler has changed from external sync reset the timing
     if (schedulerChanged) {
@@ -49,8 +54,8 @@ void Scheduler::waitForTick(Song *song, bool schedulerChanged)
     }
 
     // Calculate time of next tick (tick every 1000000/((BPM/60)*24) usecs)
-    next.tv_sec += (25 / song->tempo()) / 10;
-    next.tv_usec += ((2500000 / song->tempo()) % 1000000);
+    next.tv_sec += (25 / tempo) / 10;
+    next.tv_usec += ((2500000 / tempo) % 1000000);
     while (next.tv_usec > 1000000) {
         next.tv_sec++;
         next.tv_usec -= 1000000;
@@ -67,3 +72,97 @@ QList<Scheduler *> Scheduler::schedulers()
 {
     return schedulers_;
 }
+
+qint64 Scheduler::tickTime(qint64 tick, unsigned int tempo)
+{
+    // 24 ticks per beat: 60000000000 / (tempo * 24) nanoseconds per tick
+    return tick * Q_INT64_C(2500000000) / tempo;
+}
+
+Scheduler::Deadlines::Deadlines() :
+    base(0),
+    ticks(0),
+    tempo(0)
+{
+}
+
+void Scheduler::Deadlines::reset(qint64 base)
+{
+    this->base = base;
+    ticks = 0;
+    tempo = 0;
+}
+
+qint64 Scheduler::Deadlines::next(unsigned int tempo)
+{
+    if (this->tempo == 0) {
+        this->tempo = tempo;
+    } else if (tempo != this->tempo) {
+        // Continue from the previous tick at the new tempo
+        base += tickTime(ticks, this->tempo);
+        ticks = 0;
+        this->tempo = tempo;
+    }
+
+    ticks++;
+    return base + tickTime(ticks, tempo);
+}
+
+const LatencyHistogram &Scheduler::lateness() const
+{
+    return lateness_;
+}
+
+const LatencyHistogram &Scheduler::processing() const
+{
+    return processing_;
+}
+
+void Scheduler::setMidi(MIDI *midi)
+{
+    this->midi = midi;
+}
+
+bool Scheduler::readsInput() const
+{
+    return false;
+}
+
+unsigned int Scheduler::waitForClock()
+{
+    return 0;
+}
+
+void Scheduler::wake()
+{
+}
+
+void Scheduler::calibrate()
+{
+}
+
+QVariant Scheduler::calibration() const
+{
+    return QVariant();
+}
+
+void Scheduler::setCalibration(const QVariant &)
+{
+}
+
+void Scheduler::tickPlayed(unsigned int tempo)
+{
+    if (wakeUpTimer.isValid()) {
+        // Playing a tick should never take longer than the time between ticks
+        qint64 time = wakeUpTimer.nsecsElapsed();
+        processing_.record(time, time > tickTime(1, tempo));
+    }
+}
+
+void Scheduler::wokeUp(qint64 lateness, unsigned int tempo)
+{
+    wakeUpTimer.start();
+
+    // Waking up later than the tick after would have been due delays the tick audibly
+    lateness_.record(lateness, lateness > tickTime(1, tempo));
+}
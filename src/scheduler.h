@@ -25,27 +25,97 @@
 
 #include <QObject>
 #include <QList>
+#include <QElapsedTimer>
+#include <QtGlobal>
+#include "latencyhistogram.h"
 
-class Song;
+class MIDI;
+class QVariant;
 
 class Scheduler : public QObject
 {
     Q_OBJECT
 
 public:
+    // Deadlines of ticks played at changing tempos. Each deadline is calculated from the number of ticks
+    // since the tempo took effect so rounding errors don't accumulate.
+    class Deadlines {
+    public:
+        Deadlines();
+
+        // Counts the ticks from the given time in nanoseconds; the next tempo takes effect right away
+        void reset(qint64 base);
+
+        // Returns the deadline of the next tick played at the given tempo
+        qint64 next(unsigned int tempo);
+
+    private:
+        // Time the current tempo took effect at
+        qint64 base;
+        // Ticks played since the current tempo took effect
+        qint64 ticks;
+        // The current tempo; 0 before the first tick
+        unsigned int tempo;
+    };
+
     virtual void start(struct timeval &startTime);
-    virtual void waitForTick(Song *song, bool schedulerChanged);
+    virtual void waitForTick(unsigned int tempo, bool schedulerChanged);
     virtual void stop();
     virtual const char *name() const = 0;
     static QList<Scheduler *> schedulers();
 
+    // Returns the time of a tick in nanoseconds relative to the first tick played at the given tempo
+    static qint64 tickTime(qint64 tick, unsigned int tempo);
+
+    // Returns how late the scheduler has woken up compared with the tick deadlines since playing started
+    const LatencyHistogram &lateness() const;
+
+    // Returns how long playing each tick has taken since playing started
+    const LatencyHistogram &processing() const;
+
+    // Sets the MIDI subsystem whose input the scheduler may read
+    void setMidi(MIDI *midi);
+
+    // Returns whether the scheduler reads the MIDI input itself while playing and can wait for clock messages
+    virtual bool readsInput() const;
+
+    // Waits until MIDI clock messages arrive or wake() is called; returns the number of clock messages received
+    virtual unsigned int waitForClock();
+
+    // Makes waitForClock() return
+    virtual void wake();
+
+    // Tunes the scheduler for this machine; most schedulers have nothing to tune
+    virtual void calibrate();
+
+    // Returns the tuning found by calibrate() for storing in the settings; invalid if there is none
+    virtual QVariant calibration() const;
+
+    // Restores a tuning returned by calibration()
+    virtual void setCalibration(const QVariant &calibration);
+
 protected:
     static QList<Scheduler *> schedulers_;
 
     explicit Scheduler(QObject *parent = 0);
     virtual ~Scheduler();
 
+    // Records how long the previous tick took to play; called when starting to wait for the next tick
+    void tickPlayed(unsigned int tempo);
+
+    // Records how many nanoseconds after the deadline the scheduler woke up
+    void wokeUp(qint64 lateness, unsigned int tempo);
+
     struct timeval next, now;
+
+    // MIDI subsystem of the player using the scheduler
+    MIDI *midi;
+
+private:
+    LatencyHistogram lateness_;
+    LatencyHistogram processing_;
+    // Time since the scheduler last woke up; invalid before the first tick
+    QElapsedTimer wakeUpTimer;
 };
 
 #endif // SCHEDULER_H
@@ -0,0 +1,160 @@
+/*
+ * schedulercalibration.cpp
+ *
+ * Copyright 2002-2019 Vesa Halttunen
+ *
+ * This file is part of Tutka.
+ *
+ * Tutka is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tutka is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tutka; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <time.h>
+#include <sys/time.h>
+#include <QElapsedTimer>
+#include <QSettings>
+#include <QThread>
+#include <QVariant>
+#include "scheduler.h"
+#include "schedulernanosleep.h"
+#include "schedulercalibration.h"
+
+// Tempo the schedulers are measured at; 2 ms between ticks
+#define CALIBRATION_TEMPO 1250
+
+// Runs a scheduler for a while like the player thread does
+class CalibrationThread : public QThread
+{
+public:
+    CalibrationThread(Scheduler *scheduler, int milliseconds) :
+        scheduler(scheduler),
+        milliseconds(milliseconds),
+        cpuLoad(0)
+    {
+    }
+
+    virtual void run()
+    {
+        scheduler->calibrate();
+
+        struct timeval startTime;
+        gettimeofday(&startTime, NULL);
+        qint64 ticks = (qint64)milliseconds * 1000000 / Scheduler::tickTime(1, CALIBRATION_TEMPO);
+        qint64 cpuTimeStarted = cpuTime();
+        QElapsedTimer timer;
+        timer.start();
+
+        scheduler->start(startTime);
+        for (qint64 tick = 0; tick < ticks; tick++) {
+            scheduler->waitForTick(CALIBRATION_TEMPO, false);
+        }
+        scheduler->stop();
+
+        qint64 elapsed = timer.nsecsElapsed();
+        cpuLoad = elapsed > 0 ? (double)(cpuTime() - cpuTimeStarted) / elapsed : 0;
+    }
+
+    Scheduler *scheduler;
+    int milliseconds;
+    double cpuLoad;
+
+private:
+    // Returns the CPU time used by the calling thread in nanoseconds
+    static qint64 cpuTime()
+    {
+        struct timespec time;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+        return (qint64)time.tv_sec * 1000000000 + time.tv_nsec;
+    }
+};
+
+QList<SchedulerCalibration::Result> SchedulerCalibration::run(int milliseconds)
+{
+    QSettings settings("nongnu.org", "Tutka");
+    QList<Result> results;
+    Scheduler *bestScheduler = NULL;
+    double bestScore = 0;
+
+    foreach (Scheduler *scheduler, Scheduler::schedulers()) {
+        Result result = measure(scheduler, milliseconds);
+        results.append(result);
+
+        QString group = QString("Calibration/%1/").arg(scheduler->name());
+        settings.setValue(group + "lateness", result.lateness);
+        settings.setValue(group + "maximumLateness", result.maximumLateness);
+        settings.setValue(group + "cpuLoad", result.cpuLoad);
+        settings.setValue(group + "tuning", scheduler->calibration());
+
+        if (bestScheduler == NULL || score(result) < bestScore) {
+            bestScheduler = scheduler;
+            bestScore = score(result);
+        }
+    }
+
+    if (bestScheduler != NULL) {
+        settings.setValue("Calibration/best", bestScheduler->name());
+    }
+
+    return results;
+}
+
+bool SchedulerCalibration::restore()
+{
+    QSettings settings("nongnu.org", "Tutka");
+    if (!settings.contains("Calibration/best")) {
+        return false;
+    }
+
+    foreach (Scheduler *scheduler, Scheduler::schedulers()) {
+        scheduler->setCalibration(settings.value(QString("Calibration/%1/tuning").arg(scheduler->name())));
+    }
+
+    return true;
+}
+
+Scheduler *SchedulerCalibration::best()
+{
+    QSettings settings("nongnu.org", "Tutka");
+    QString name = settings.value("Calibration/best").toString();
+
+    QList<Scheduler *> schedulers = Scheduler::schedulers();
+    foreach (Scheduler *scheduler, schedulers) {
+        if (name == scheduler->name()) {
+            return scheduler;
+        }
+    }
+
+    return schedulers.isEmpty() ? &SchedulerNanoSleep::instance : schedulers.first();
+}
+
+SchedulerCalibration::Result SchedulerCalibration::measure(Scheduler *scheduler, int milliseconds)
+{
+    CalibrationThread thread(scheduler, milliseconds);
+    thread.start(QThread::TimeCriticalPriority);
+    thread.wait();
+
+    Result result;
+    result.scheduler = scheduler->name();
+    result.lateness = scheduler->lateness().percentile(0.99);
+    result.maximumLateness = scheduler->lateness().maximum();
+    result.cpuLoad = thread.cpuLoad;
+
+    return result;
+}
+
+double SchedulerCalibration::score(const Result &result)
+{
+    // A core kept fully busy counts as much as a millisecond of lateness
+    return result.lateness + result.cpuLoad * 1000000;
+}
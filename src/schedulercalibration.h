@@ -0,0 +1,66 @@
+/*
+ * schedulercalibration.h
+ *
+ * Copyright 2002-2019 Vesa Halttunen
+ *
+ * This file is part of Tutka.
+ *
+ * Tutka is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tutka is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tutka; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SCHEDULERCALIBRATION_H
+#define SCHEDULERCALIBRATION_H
+
+#include <QList>
+#include <QString>
+
+class Scheduler;
+
+// Measures how accurately and at what CPU cost each available scheduler
+// wakes up on this machine and picks the best one. The results are stored
+// in the settings so the measurement only needs to be done once.
+class SchedulerCalibration {
+public:
+    // Measurement of a scheduler
+    class Result {
+    public:
+        // Name of the scheduler
+        QString scheduler;
+        // 99th percentile of the wake-up lateness in nanoseconds
+        qint64 lateness;
+        // Maximum wake-up lateness in nanoseconds
+        qint64 maximumLateness;
+        // Fraction of a core used while waiting
+        double cpuLoad;
+    };
+
+    // Calibrates and measures each scheduler for the given number of milliseconds and stores the results
+    static QList<Result> run(int milliseconds = 250);
+
+    // Restores the stored calibrations to the schedulers; returns false if the schedulers haven't been calibrated
+    static bool restore();
+
+    // Returns the best scheduler according to the stored results or the first scheduler if not calibrated; never NULL
+    static Scheduler *best();
+
+private:
+    // Measures a scheduler in a thread running at the player's priority
+    static Result measure(Scheduler *scheduler, int milliseconds);
+
+    // Returns a score for a result; the lower the better
+    static double score(const Result &result);
+};
+
+#endif // SCHEDULERCALIBRATION_H
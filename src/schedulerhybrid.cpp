@@ -0,0 +1,133 @@
+/*
+ * schedulerhybrid.cpp
+ *
+ * Copyright 2002-2019 Vesa Halttunen
+ *
+ * This file is part of Tutka.
+ *
+ * Tutka is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tutka is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tutka; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <errno.h>
+#include <time.h>
+#include <QVariant>
+#include "latencyhistogram.h"
+#include "schedulerhybrid.h"
+
+// Spin threshold used until calibrated
+#define DEFAULT_SPIN_THRESHOLD 200000
+// Bounds for the calibrated spin threshold
+#define MINIMUM_SPIN_THRESHOLD 20000
+#define MAXIMUM_SPIN_THRESHOLD 2000000
+
+SchedulerHybrid::SchedulerHybrid(QObject *parent) :
+    Scheduler(parent),
+    spinThreshold(DEFAULT_SPIN_THRESHOLD),
+    base(0),
+    ticks(0),
+    tempo(0)
+{
+    schedulers_.append(this);
+}
+
+const char *SchedulerHybrid::name() const
+{
+    return "Hybrid";
+}
+
+void SchedulerHybrid::start(struct timeval &startTime)
+{
+    Scheduler::start(startTime);
+
+    base = monotonicTime();
+    ticks = 0;
+    tempo = 0;
+}
+
+void SchedulerHybrid::waitForTick(unsigned int tempo, bool schedulerChanged)
+{
+    tickPlayed(tempo);
+
+    if (schedulerChanged || this->tempo == 0) {
+        // If the scheduler has changed from external sync reset the timing
+        if (schedulerChanged) {
+            base = monotonicTime();
+        }
+        ticks = 0;
+        this->tempo = tempo;
+    } else if (tempo != this->tempo) {
+        // Continue from the previous tick at the new tempo
+        base += tickTime(ticks, this->tempo);
+        ticks = 0;
+        this->tempo = tempo;
+    }
+
+    ticks++;
+    qint64 deadline = base + tickTime(ticks, tempo);
+
+    // Sleep while it is safe and spin the rest of the way
+    if (deadline - monotonicTime() > spinThreshold) {
+        sleepUntil(deadline - spinThreshold);
+    }
+    qint64 time = monotonicTime();
+    while (time < deadline) {
+        time = monotonicTime();
+    }
+
+    wokeUp(time - deadline, tempo);
+}
+
+void SchedulerHybrid::calibrate()
+{
+    // Find out how late sleeping wakes up; spinning has to cover nearly all of it
+    LatencyHistogram lateness;
+    for (int sleep = 0; sleep < 200; sleep++) {
+        qint64 deadline = monotonicTime() + 500000;
+        sleepUntil(deadline);
+        lateness.record(monotonicTime() - deadline);
+    }
+
+    qint64 threshold = lateness.percentile(0.99) * 5 / 4;
+    spinThreshold = qBound((qint64)MINIMUM_SPIN_THRESHOLD, threshold, (qint64)MAXIMUM_SPIN_THRESHOLD);
+}
+
+QVariant SchedulerHybrid::calibration() const
+{
+    return spinThreshold;
+}
+
+void SchedulerHybrid::setCalibration(const QVariant &calibration)
+{
+    if (calibration.isValid()) {
+        spinThreshold = qBound((qint64)MINIMUM_SPIN_THRESHOLD, calibration.toLongLong(), (qint64)MAXIMUM_SPIN_THRESHOLD);
+    }
+}
+
+qint64 SchedulerHybrid::monotonicTime()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (qint64)time.tv_sec * 1000000000 + time.tv_nsec;
+}
+
+void SchedulerHybrid::sleepUntil(qint64 time)
+{
+    struct timespec req;
+    req.tv_sec = time / 1000000000;
+    req.tv_nsec = time % 1000000000;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &req, NULL) == EINTR) { };
+}
+
+SchedulerHybrid SchedulerHybrid::instance;
@@ -0,0 +1,66 @@
+/*
+ * schedulerhybrid.h
+ *
+ * Copyright 2002-2019 Vesa Halttunen
+ *
+ * This file is part of Tutka.
+ *
+ * Tutka is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tutka is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tutka; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SCHEDULERHYBRID_H
+#define SCHEDULERHYBRID_H
+
+#include <QtGlobal>
+#include "scheduler.h"
+
+// Sleeps until shortly before the tick deadline and spins for the rest of
+// the time, so the wake-up is as accurate as spinning without burning a
+// core for the whole tick. The time spent spinning is calibrated from how
+// late sleeping wakes up on this machine.
+class SchedulerHybrid : public Scheduler
+{
+    Q_OBJECT
+
+public:
+    virtual const char *name() const;
+    virtual void start(struct timeval &startTime);
+    virtual void waitForTick(unsigned int tempo, bool schedulerChanged);
+    virtual void calibrate();
+    virtual QVariant calibration() const;
+    virtual void setCalibration(const QVariant &calibration);
+
+private:
+    explicit SchedulerHybrid(QObject *parent = 0);
+
+    // Returns the current CLOCK_MONOTONIC time in nanoseconds
+    static qint64 monotonicTime();
+
+    // Sleeps until the given CLOCK_MONOTONIC time in nanoseconds
+    static void sleepUntil(qint64 time);
+
+    // How many nanoseconds before the deadline to stop sleeping and start spinning
+    qint64 spinThreshold;
+    // Time the current tempo took effect at
+    qint64 base;
+    // Ticks played since the current tempo took effect
+    qint64 ticks;
+    // The current tempo
+    unsigned int tempo;
+
+    static SchedulerHybrid instance;
+};
+
+#endif // SCHEDULERHYBRID_H
@@ -0,0 +1,70 @@
+/*
+ * schedulermonotonic.cpp
+ *
+ * Copyright 2002-2019 Vesa Halttunen
+ *
+ * This file is part of Tutka.
+ *
+ * Tutka is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tutka is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tutka; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <errno.h>
+#include <time.h>
+#include "schedulermonotonic.h"
+
+SchedulerMonotonic::SchedulerMonotonic(QObject *parent) :
+    Scheduler(parent)
+{
+    schedulers_.append(this);
+}
+
+const char *SchedulerMonotonic::name() const
+{
+    return "Monotonic";
+}
+
+void SchedulerMonotonic::start(struct timeval &startTime)
+{
+    Scheduler::start(startTime);
+
+    deadlines.reset(monotonicTime());
+}
+
+void SchedulerMonotonic::waitForTick(unsigned int tempo, bool schedulerChanged)
+{
+    tickPlayed(tempo);
+
+    // If the scheduler has changed from external sync reset the timing
+    if (schedulerChanged) {
+        deadlines.reset(monotonicTime());
+    }
+    qint64 deadline = deadlines.next(tempo);
+
+    struct timespec req;
+    req.tv_sec = deadline / 1000000000;
+    req.tv_nsec = deadline % 1000000000;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &req, NULL) == EINTR) { };
+
+    wokeUp(monotonicTime() - deadline, tempo);
+}
+
+qint64 SchedulerMonotonic::monotonicTime()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (qint64)time.tv_sec * 1000000000 + time.tv_nsec;
+}
+
+SchedulerMonotonic SchedulerMonotonic::instance;
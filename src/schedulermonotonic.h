@@ -0,0 +1,50 @@
+/*
+ * schedulermonotonic.h
+ *
+ * Copyright 2002-2019 Vesa Halttunen
+ *
+ * This file is part of Tutka.
+ *
+ * Tutka is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tutka is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tutka; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SCHEDULERMONOTONIC_H
+#define SCHEDULERMONOTONIC_H
+
+#include <QtGlobal>
+#include "scheduler.h"
+
+class SchedulerMonotonic : public Scheduler
+{
+    Q_OBJECT
+
+public:
+    virtual const char *name() const;
+    virtual void start(struct timeval &startTime);
+    virtual void waitForTick(unsigned int tempo, bool schedulerChanged);
+
+private:
+    explicit SchedulerMonotonic(QObject *parent = 0);
+
+    // Returns the current CLOCK_MONOTONIC time in nanoseconds
+    static qint64 monotonicTime();
+
+    // Deadlines of the ticks since playing started or the scheduler changed
+    Deadlines deadlines;
+
+    static SchedulerMonotonic instance;
+};
+
+#endif // SCHEDULERMONOTONIC_H
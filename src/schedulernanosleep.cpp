@@ -20,6 +20,8 @@
  * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  */
 
+#include <time.h>
+#include <sys/time.h>
 #include "schedulernanosleep.h"
 
 SchedulerNanoSleep::SchedulerNanoSleep(QObject *parent) :
@@ -33,9 +35,11 @@ const char *SchedulerNanoSleep::name() const
     return "NanoSleep";
 }
 
-void SchedulerNanoSleep::waitForTick(Song *song, bool schedulerChanged)
+void SchedulerNanoSleep::waitForTick(unsigned int tempo, bool schedulerChanged)
 {
-    Scheduler::waitForTick(song, schedulerChanged);
+    tickPlayed(tempo);
+
+    Scheduler::waitForTick(tempo, schedulerChanged);
 
     // Nanosleep: calculate difference between now and the next tick
     struct timespec req, rem;
@@ -50,6 +54,9 @@ void SchedulerNanoSleep::waitForTick(Song *song, bool schedulerChanged)
     if (req.tv_sec >= 0) {
         while (nanosleep(&req, &rem) == -1) { };
     }
+
+    gettimeofday(&now, NULL);
+    wokeUp(((qint64)(now.tv_sec - next.tv_sec) * 1000000 + (now.tv_usec - next.tv_usec)) * 1000, tempo);
 }
 
 SchedulerNanoSleep SchedulerNanoSleep::instance;
@@ -31,12 +31,13 @@ class SchedulerNanoSleep : public Scheduler
 
 public:
     virtual const char *name() const;
-    virtual void waitForTick(Song *song, bool schedulerChanged);
+    virtual void waitForTick(unsigned int tempo, bool schedulerChanged);
+
+    // Works on every system so it is also the scheduler to fall back to
+    static SchedulerNanoSleep instance;
 
 private:
     explicit SchedulerNanoSleep(QObject *parent = 0);
-
-    static SchedulerNanoSleep instance;
 };
 
 #endif // SCHEDULERNANOSLEEP_H
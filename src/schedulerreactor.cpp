@@ -0,0 +1,202 @@
+/*
+ * schedulerreactor.cpp
+ *
+ * Copyright 2002-2019 Vesa Halttunen
+ *
+ * This file is part of Tutka.
+ *
+ * Tutka is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tutka is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tutka; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include "midi.h"
+#include "schedulerreactor.h"
+
+SchedulerReactor::SchedulerReactor(QObject *parent) :
+    Scheduler(parent),
+    epoll(epoll_create1(EPOLL_CLOEXEC)),
+    timer(timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)),
+    wakeUp(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+    base(0),
+    ticks(0),
+    tempo(0)
+{
+    if (epoll != -1 && timer != -1 && wakeUp != -1) {
+        struct epoll_event event;
+        event.events = EPOLLIN;
+        event.data.fd = timer;
+        epoll_ctl(epoll, EPOLL_CTL_ADD, timer, &event);
+        event.data.fd = wakeUp;
+        epoll_ctl(epoll, EPOLL_CTL_ADD, wakeUp, &event);
+
+        schedulers_.append(this);
+    }
+}
+
+SchedulerReactor::~SchedulerReactor()
+{
+    if (wakeUp != -1) {
+        close(wakeUp);
+    }
+    if (timer != -1) {
+        close(timer);
+    }
+    if (epoll != -1) {
+        close(epoll);
+    }
+}
+
+const char *SchedulerReactor::name() const
+{
+    return "Reactor";
+}
+
+void SchedulerReactor::start(struct timeval &startTime)
+{
+    Scheduler::start(startTime);
+
+    base = monotonicTime();
+    ticks = 0;
+    tempo = 0;
+
+    // Forget wake-ups meant for an earlier run
+    eventfd_t value;
+    eventfd_read(wakeUp, &value);
+
+    // Read the MIDI input in the player thread while playing
+    if (midi != NULL) {
+        midi->acquireInput();
+        inputDescriptors = midi->inputDescriptors();
+        foreach (int descriptor, inputDescriptors) {
+            struct epoll_event event;
+            event.events = EPOLLIN;
+            event.data.fd = descriptor;
+            epoll_ctl(epoll, EPOLL_CTL_ADD, descriptor, &event);
+        }
+    }
+}
+
+void SchedulerReactor::waitForTick(unsigned int tempo, bool schedulerChanged)
+{
+    tickPlayed(tempo);
+
+    if (schedulerChanged || this->tempo == 0) {
+        // If the scheduler has changed from external sync reset the timing
+        if (schedulerChanged) {
+            base = monotonicTime();
+        }
+        ticks = 0;
+        this->tempo = tempo;
+    } else if (tempo != this->tempo) {
+        // Continue from the previous tick at the new tempo
+        base += tickTime(ticks, this->tempo);
+        ticks = 0;
+        this->tempo = tempo;
+    }
+
+    ticks++;
+    qint64 deadline = base + tickTime(ticks, tempo);
+
+    struct itimerspec expiration;
+    expiration.it_interval.tv_sec = 0;
+    expiration.it_interval.tv_nsec = 0;
+    expiration.it_value.tv_sec = deadline / 1000000000;
+    expiration.it_value.tv_nsec = deadline % 1000000000;
+    timerfd_settime(timer, TFD_TIMER_ABSTIME, &expiration, NULL);
+
+    // Clock messages don't matter when playing with the internal clock but the other input is handled meanwhile
+    bool timerExpired = false, woken = false;
+    while (!timerExpired) {
+        waitForEvents(timerExpired, woken);
+    }
+
+    wokeUp(monotonicTime() - deadline, tempo);
+}
+
+void SchedulerReactor::stop()
+{
+    if (midi != NULL) {
+        foreach (int descriptor, inputDescriptors) {
+            epoll_ctl(epoll, EPOLL_CTL_DEL, descriptor, NULL);
+        }
+        inputDescriptors.clear();
+        midi->releaseInput();
+    }
+}
+
+bool SchedulerReactor::readsInput() const
+{
+    return !inputDescriptors.isEmpty();
+}
+
+unsigned int SchedulerReactor::waitForClock()
+{
+    // The timer is not armed so only the input and wake() end the wait
+    bool timerExpired = false, woken = false;
+    unsigned int clocks = 0;
+    while (clocks == 0 && !woken) {
+        clocks = waitForEvents(timerExpired, woken);
+    }
+
+    return clocks;
+}
+
+void SchedulerReactor::wake()
+{
+    eventfd_write(wakeUp, 1);
+}
+
+unsigned int SchedulerReactor::waitForEvents(bool &timerExpired, bool &woken)
+{
+    struct epoll_event events[8];
+    int count = epoll_wait(epoll, events, 8, -1);
+
+    unsigned int clocks = 0;
+    bool inputReady = false;
+    for (int event = 0; event < count; event++) {
+        if (events[event].data.fd == timer) {
+            uint64_t expirations;
+            if (read(timer, &expirations, sizeof(expirations)) == sizeof(expirations)) {
+                timerExpired = true;
+            }
+        } else if (events[event].data.fd == wakeUp) {
+            eventfd_t value;
+            if (eventfd_read(wakeUp, &value) == 0) {
+                woken = true;
+            }
+        } else {
+            inputReady = true;
+        }
+    }
+
+    if (inputReady && midi != NULL) {
+        clocks = midi->readInput();
+    }
+
+    return clocks;
+}
+
+qint64 SchedulerReactor::monotonicTime()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (qint64)time.tv_sec * 1000000000 + time.tv_nsec;
+}
+
+SchedulerReactor SchedulerReactor::instance;
@@ -0,0 +1,74 @@
+/*
+ * schedulerreactor.h
+ *
+ * Copyright 2002-2019 Vesa Halttunen
+ *
+ * This file is part of Tutka.
+ *
+ * Tutka is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Tutka is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tutka; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SCHEDULERREACTOR_H
+#define SCHEDULERREACTOR_H
+
+#include <QtGlobal>
+#include <QList>
+#include "scheduler.h"
+
+// Waits for the tick deadlines on a timerfd and for the MIDI input on the
+// same epoll set, so the player thread reads incoming clock messages itself
+// instead of being woken up by the input thread.
+class SchedulerReactor : public Scheduler
+{
+    Q_OBJECT
+
+public:
+    virtual const char *name() const;
+    virtual void start(struct timeval &startTime);
+    virtual void waitForTick(unsigned int tempo, bool schedulerChanged);
+    virtual void stop();
+    virtual bool readsInput() const;
+    virtual unsigned int waitForClock();
+    virtual void wake();
+
+private:
+    explicit SchedulerReactor(QObject *parent = 0);
+    virtual ~SchedulerReactor();
+
+    // Waits for the next events; returns the number of clock messages read and tells whether the timer expired or wake() was called
+    unsigned int waitForEvents(bool &timerExpired, bool &woken);
+
+    // Returns the current CLOCK_MONOTONIC time in nanoseconds
+    static qint64 monotonicTime();
+
+    // epoll descriptor waiting for the timer, the wake up event and the MIDI input
+    int epoll;
+    // Expires at the tick deadlines
+    int timer;
+    // Signaled by wake()
+    int wakeUp;
+    // MIDI input descriptors added to the epoll set
+    QList<int> inputDescriptors;
+    // Time the current tempo took effect at
+    qint64 base;
+    // Ticks played since the current tempo took effect
+    qint64 ticks;
+    // The current tempo
+    unsigned int tempo;
+
+    static SchedulerReactor instance;
+};
+
+#endif // SCHEDULERREACTOR_H
@@ -82,9 +82,11 @@ const char *SchedulerRTC::name() const
     return "RTC";
 }
 
-void SchedulerRTC::waitForTick(Song *song, bool schedulerChanged)
+void SchedulerRTC::waitForTick(unsigned int tempo, bool schedulerChanged)
 {
-    Scheduler::waitForTick(song, schedulerChanged);
+    tickPlayed(tempo);
+
+    Scheduler::waitForTick(tempo, schedulerChanged);
 
     if (rtc != -1) {
         // Make sure periodic interrupts are on
@@ -105,6 +107,8 @@ void SchedulerRTC::waitForTick(Song *song, bool schedulerChanged)
         while ((next.tv_sec - now.tv_sec) > 0 || ((next.tv_sec - now.tv_sec) == 0 && (next.tv_usec - now.tv_usec) > 0)) {
             gettimeofday(&now, NULL);
         }
+
+        wokeUp(((qint64)(now.tv_sec - next.tv_sec) * 1000000 + (now.tv_usec - next.tv_usec)) * 1000, tempo);
     }
 }
 
@@ -31,7 +31,7 @@ class SchedulerRTC : public Scheduler
 
 public:
     virtual const char *name() const;
-    virtual void waitForTick(Song *song, bool schedulerChanged);
+    virtual void waitForTick(unsigned int tempo, bool schedulerChanged);
     virtual void stop();
 
 private:
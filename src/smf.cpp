@@ -23,7 +23,8 @@
 #include <QFile>
 #include "smf.h"
 
-SMF::SMF()
+SMF::SMF(unsigned short format) :
+    format(format)
 {
 }
 
@@ -32,14 +33,19 @@ void SMF::addTrack(const QByteArray &data)
     tracks.append(SMFTrack(data));
 }
 
-void SMF::save(const QString &path) const
+bool SMF::save(const QString &path) const
 {
     QFile file(path);
-    file.open(QIODevice::WriteOnly);
-    file.write(header.toByteArray());
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    bool success = file.write(SMFHeader(format, tracks.count()).toByteArray()) >= 0;
     foreach(const SMFTrack &track, tracks) {
-        file.write(track.toByteArray());
+        success = success && file.write(track.toByteArray()) >= 0;
     }
+
+    return success;
 }
 
 SMFChunk::SMFChunk(unsigned int id) : id(id)
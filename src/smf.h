@@ -49,13 +49,13 @@ public:
 class SMF
 {
 public:
-    SMF();
+    SMF(unsigned short format = 0);
 
     void addTrack(const QByteArray &data);
-    void save(const QString &path) const;
+    bool save(const QString &path) const;
 
 private:
-    SMFHeader header;
+    unsigned short format;
     QList<SMFTrack> tracks;
 };
 
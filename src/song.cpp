@@ -29,6 +29,7 @@
 Song::Song(const QString &path, QObject *parent) :
     QObject(parent),
     path_(path),
+    updating(1),
     modified(false)
 {
     bool initialized = false;
@@ -65,6 +66,13 @@ Song::Song(const QString &path, QObject *parent) :
     connect(this, SIGNAL(masterVolumeChanged()), this, SLOT(setModified()));
     connect(this, SIGNAL(ticksPerLineChanged()), this, SLOT(setModified()));
     connect(this, SIGNAL(tempoChanged()), this, SLOT(setModified()));
+    connect(this, SIGNAL(messagesChanged(unsigned int)), this, SLOT(publishSnapshot()));
+    connect(this, SIGNAL(maxTracksChanged(unsigned int)), this, SLOT(publishSnapshot()));
+    connect(this, SIGNAL(trackMutedOrSoloed()), this, SLOT(publishSnapshot()));
+    connect(this, SIGNAL(sendSyncChanged()), this, SLOT(publishSnapshot()));
+    connect(this, SIGNAL(masterVolumeChanged()), this, SLOT(publishSnapshot()));
+
+    endUpdate();
 }
 
 Song::~Song()
@@ -222,7 +230,7 @@ Message *Song::message(unsigned int number) const
 
 void Song::insertBlock(unsigned int pos, unsigned int current)
 {
-    mutex.lock();
+    beginUpdate();
 
     // Check block existence
     if (pos > blocks_.count()) {
@@ -246,7 +254,7 @@ void Song::insertBlock(unsigned int pos, unsigned int current)
         }
     }
 
-    mutex.unlock();
+    endUpdate();
 
     emit blocksChanged(blocks_.count());
 }
@@ -255,7 +263,7 @@ void Song::deleteBlock(unsigned int pos)
 {
     // Don't delete the last block
     if (blocks_.count() > 1) {
-        mutex.lock();
+        beginUpdate();
 
         // Check block existence
         if (pos >= blocks_.count()) {
@@ -273,7 +281,7 @@ void Song::deleteBlock(unsigned int pos)
             }
         }
 
-        mutex.unlock();
+        endUpdate();
 
         emit blocksChanged(blocks_.count());
 
@@ -283,7 +291,7 @@ void Song::deleteBlock(unsigned int pos)
 
 void Song::splitBlock(unsigned int pos, unsigned int line)
 {
-    mutex.lock();
+    beginUpdate();
 
     // Check block existence
     if (pos > blocks_.count()) {
@@ -306,7 +314,7 @@ void Song::splitBlock(unsigned int pos, unsigned int line)
         }
     }
 
-    mutex.unlock();
+    endUpdate();
 
     emit blocksChanged(blocks_.count());
 }
@@ -314,7 +322,7 @@ void Song::splitBlock(unsigned int pos, unsigned int line)
 // Inserts a new playseq in the playseq array in the given position
 void Song::insertPlayseq(unsigned int pos)
 {
-    mutex.lock();
+    beginUpdate();
 
     // Check playseq existence
     if (pos > playseqs_.count()) {
@@ -333,7 +341,7 @@ void Song::insertPlayseq(unsigned int pos)
         }
     }
 
-    mutex.unlock();
+    endUpdate();
 
     emit playseqsChanged(playseqs_.count());
 }
@@ -342,7 +350,7 @@ void Song::deletePlayseq(unsigned int pos)
 {
     // Don't delete the last playseq
     if (playseqs_.count() > 1) {
-        mutex.lock();
+        beginUpdate();
 
         // Check playseq existence
         if (pos >= playseqs_.count()) {
@@ -358,7 +366,7 @@ void Song::deletePlayseq(unsigned int pos)
             }
         }
 
-        mutex.unlock();
+        endUpdate();
 
         emit playseqsChanged(playseqs_.count());
 
@@ -368,7 +376,7 @@ void Song::deletePlayseq(unsigned int pos)
 
 void Song::insertSection(unsigned int pos)
 {
-    mutex.lock();
+    beginUpdate();
 
     // Check that the value is possible
     if (pos > sections_.count()) {
@@ -377,7 +385,7 @@ void Song::insertSection(unsigned int pos)
 
     sections_.insert(pos, pos < sections_.count() ? sections_[pos] : sections_[sections_.count() - 1]);
 
-    mutex.unlock();
+    endUpdate();
 
     emit sectionsChanged(sections_.count());
 }
@@ -386,7 +394,7 @@ void Song::deleteSection(unsigned int pos)
 {
     // Don't delete the last section
     if (sections_.count() > 1) {
-        mutex.lock();
+        beginUpdate();
 
         // Check section existence
         if (pos >= sections_.count()) {
@@ -395,7 +403,7 @@ void Song::deleteSection(unsigned int pos)
 
         sections_.removeAt(pos);
 
-        mutex.unlock();
+        endUpdate();
     }
 
     emit sectionsChanged(sections_.count());
@@ -409,7 +417,9 @@ void Song::insertMessage(unsigned int pos)
     }
 
     // Insert a new message
-    messages_.insert(pos, new Message());
+    Message *message = new Message();
+    connectMessageSignals(message);
+    messages_.insert(pos, message);
 
     emit messagesChanged(messages_.count());
 }
@@ -433,12 +443,9 @@ void Song::deleteMessage(unsigned int pos)
 void Song::setSection(unsigned int pos, unsigned int playseq)
 {
     if (pos < sections_.count() && playseq < playseqs_.count()) {
-        mutex.lock();
-
         sections_[pos] = playseq;
 
-        mutex.unlock();
-
+        publishSnapshot();
         setModified();
     }
 }
@@ -492,42 +499,65 @@ void Song::checkMaxTracks()
 
 void Song::checkInstrument(int instrument)
 {
+    bool added = false;
+
     while (instrument >= instruments_.count()) {
         Instrument *instrument = new Instrument(tr("Unnamed"));
         connectInstrumentSignals(instrument);
         instruments_.append(instrument);
+        added = true;
+    }
+
+    publishSnapshot();
+
+    if (added) {
+        emit instrumentRoutingChanged();
     }
 }
 
 void Song::transpose(int instrument, int halfNotes)
 {
+    beginUpdate();
+
     for (int block = 0; block < blocks_.count(); block++) {
         blocks_[block]->transpose(instrument, halfNotes, 0, 0, blocks_[block]->tracks() - 1, blocks_[block]->length() - 1);
     }
+
+    endUpdate();
 }
 
 void Song::expandShrink(int factor, bool changeBlockLength)
 {
+    beginUpdate();
+
     for (int block = 0; block < blocks_.count(); block++) {
         blocks_[block]->expandShrink(factor, 0, 0, blocks_[block]->tracks() - 1, blocks_[block]->length() - 1, changeBlockLength);
     }
+
+    endUpdate();
 }
 
 void Song::changeInstrument(int from, int to, bool swap)
 {
+    beginUpdate();
+
     for (int block = 0; block < blocks_.count(); block++) {
         blocks_[block]->changeInstrument(from, to, swap, 0, 0, blocks_[block]->tracks() - 1, blocks_[block]->length() - 1);
     }
+
+    endUpdate();
 }
 
 void Song::insertTrack(int track)
 {
     addTrack(track, tr("Track %1").arg(track + 1));
+    beginUpdate();
     for (int block = 0; block < blocks_.count(); block++) {
         disconnect(blocks_[block], SIGNAL(tracksChanged(int)), this, SLOT(checkMaxTracks()));
         blocks_[block]->insertTrack(track);
         connect(blocks_[block], SIGNAL(tracksChanged(int)), this, SLOT(checkMaxTracks()));
     }
+    endUpdate();
 
     // Maximum number of tracks will have changed since a track has been added to every block
     emit maxTracksChanged(tracks.count());
@@ -538,11 +568,13 @@ void Song::insertTrack(int track)
 void Song::deleteTrack(int track)
 {
     if (maxTracks() > 1) {
+        beginUpdate();
         for (int block = 0; block < blocks_.count(); block++) {
             disconnect(blocks_[block], SIGNAL(tracksChanged(int)), this, SLOT(checkMaxTracks()));
             blocks_[block]->deleteTrack(track);
             connect(blocks_[block], SIGNAL(tracksChanged(int)), this, SLOT(checkMaxTracks()));
         }
+        endUpdate();
         Track *trackToBeDeleted = tracks.takeAt(track);
 
         // Maximum number of tracks will have changed since a track has been deleted from every block
@@ -803,8 +835,11 @@ bool Song::parse(QDomElement element)
                                 number = prop.value().toInt();
                             }
 
+                            connectMessageSignals(message);
                             while (messages_.count() < number) {
-                                messages_.append(new Message);
+                                Message *empty = new Message;
+                                connectMessageSignals(empty);
+                                messages_.append(empty);
                             }
                             if (messages_.count() == number) {
                                 messages_.append(message);
@@ -918,14 +953,66 @@ void Song::save(const QString &path)
     setModified(false);
 }
 
-void Song::lock()
+QSharedPointer<const SongSnapshot> Song::snapshot() const
+{
+    snapshotMutex.lock();
+    QSharedPointer<const SongSnapshot> snapshot = snapshot_;
+    snapshotMutex.unlock();
+
+    return snapshot;
+}
+
+void Song::publishSnapshot()
+{
+    if (updating > 0) {
+        return;
+    }
+
+    SongSnapshot *snapshot = new SongSnapshot;
+    snapshot->sections = sections_;
+    foreach(Playseq *playseq, playseqs_) {
+        snapshot->playseqs.append(playseq->blockList());
+    }
+    foreach(Block *block, blocks_) {
+        snapshot->blocks.append(block->timeline());
+    }
+    foreach(Instrument *instrument, instruments_) {
+        snapshot->arpeggios.append(instrument->arpeggio() != NULL ? instrument->arpeggio()->timeline() : QSharedPointer<const BlockTimeline>());
+        snapshot->holds.append(instrument->hold());
+        snapshot->arpeggioBaseNotes.append(instrument->arpeggioBaseNote());
+        snapshot->transposes.append(instrument->transpose());
+    }
+    snapshot->solo = false;
+    foreach(Track *track, tracks) {
+        snapshot->muted.append(track->isMuted());
+        snapshot->soloed.append(track->isSolo());
+        snapshot->solo |= track->isSolo();
+    }
+    foreach(Message *message, messages_) {
+        snapshot->messages.append(message->data());
+    }
+    snapshot->masterVolume = masterVolume_;
+    snapshot->sendSync = sendSync_;
+
+    // The previous snapshot is freed when the last reader lets go of it, outside the lock
+    QSharedPointer<const SongSnapshot> published(snapshot);
+    snapshotMutex.lock();
+    snapshot_.swap(published);
+    snapshotMutex.unlock();
+
+    emit snapshotChanged();
+}
+
+void Song::beginUpdate()
 {
-    mutex.lock();
+    updating++;
 }
 
-void Song::unlock()
+void Song::endUpdate()
 {
-    mutex.unlock();
+    updating--;
+
+    publishSnapshot();
 }
 
 void Song::addTrack(int index, const QString &name)
@@ -947,6 +1034,7 @@ void Song::connectBlockSignals(Block *block)
     connect(block, SIGNAL(lengthChanged(int)), this, SIGNAL(blockLengthChanged()));
     connect(block, SIGNAL(nameChanged(QString)), this, SIGNAL(blockNameChanged()));
     connect(block, SIGNAL(areaChanged(int, int, int, int)), this, SLOT(setModified()));
+    connect(block, SIGNAL(areaChanged(int, int, int, int)), this, SLOT(publishSnapshot()));
     connect(block, SIGNAL(tracksChanged(int)), this, SLOT(setModified()));
     connect(block, SIGNAL(commandPagesChanged(int)), this, SLOT(setModified()));
 }
@@ -956,11 +1044,24 @@ void Song::connectPlayseqSignals(Playseq *playseq)
     connect(playseq, SIGNAL(nameChanged(QString)), this, SIGNAL(playseqNameChanged()));
     connect(playseq, SIGNAL(lengthChanged()), this, SLOT(setModified()));
     connect(playseq, SIGNAL(blocksChanged()), this, SLOT(setModified()));
+    connect(playseq, SIGNAL(lengthChanged()), this, SLOT(publishSnapshot()));
+    connect(playseq, SIGNAL(blocksChanged()), this, SLOT(publishSnapshot()));
 }
 
 void Song::connectInstrumentSignals(Instrument *instrument)
 {
     connect(instrument, SIGNAL(nameChanged(QString)), this, SLOT(setModified()));
+    connect(instrument, SIGNAL(arpeggioChanged()), this, SLOT(publishSnapshot()));
+    connect(instrument, SIGNAL(holdChanged(int)), this, SLOT(publishSnapshot()));
+    connect(instrument, SIGNAL(arpeggioBaseNoteChanged(int)), this, SLOT(publishSnapshot()));
+    connect(instrument, SIGNAL(transposeChanged(int)), this, SLOT(publishSnapshot()));
+    connect(instrument, SIGNAL(routingChanged()), this, SIGNAL(instrumentRoutingChanged()));
+    connect(instrument, SIGNAL(defaultVelocityChanged(int)), this, SIGNAL(instrumentVelocityChanged()));
+}
+
+void Song::connectMessageSignals(Message *message)
+{
+    connect(message, SIGNAL(dataChanged()), this, SLOT(publishSnapshot()));
 }
 
 bool Song::isModified() const
@@ -25,6 +25,8 @@
 
 #include <QObject>
 #include <QMutex>
+#include <QSharedPointer>
+#include <QVector>
 #include "playseq.h"
 #include "block.h"
 #include "instrument.h"
@@ -33,6 +35,34 @@
 class QDomElement;
 class Track;
 
+// An immutable copy of the song structure and the compiled blocks for the player.
+// A new one is published after each change instead of modifying the old one.
+class SongSnapshot {
+public:
+    // Playing sequence of each section
+    QList<unsigned int> sections;
+    // Blocks of each playing sequence
+    QList<QList<unsigned int> > playseqs;
+    // Compiled blocks
+    QList<QSharedPointer<const BlockTimeline> > blocks;
+    // Compiled arpeggio of each instrument; null if the instrument has no arpeggio
+    QList<QSharedPointer<const BlockTimeline> > arpeggios;
+    // Hold and arpeggio base note of each instrument
+    QVector<unsigned char> holds;
+    QVector<unsigned char> arpeggioBaseNotes;
+    // Transpose of each instrument
+    QVector<int> transposes;
+    // Whether each track is muted or soloed
+    QVector<bool> muted;
+    QVector<bool> soloed;
+    // Whether some track is soloed
+    bool solo;
+    // Contents of each System Exclusive message
+    QList<QByteArray> messages;
+    unsigned int masterVolume;
+    bool sendSync;
+};
+
 class Song : public QObject {
     Q_OBJECT
 
@@ -151,15 +181,18 @@ public:
     // Saves a song to an XML file
     void save(const QString &path);
 
-    // Locks the song
-    void lock();
-
-    // Unlocks the song
-    void unlock();
+    // Returns the most recently published snapshot of the song structure
+    QSharedPointer<const SongSnapshot> snapshot() const;
 
     // Returns true if the song has been modified since it was saved, false otherwise
     bool isModified() const;
 
+    // Defers publishing snapshots until a multi-step change is complete; calls may be nested
+    void beginUpdate();
+
+    // Publishes a snapshot of a completed change
+    void endUpdate();
+
 public slots:
     // Sets the number of ticks per line for the song
     void setTPL(int ticksPerLine);
@@ -180,6 +213,9 @@ private slots:
     // If the maximum number of tracks has changed recreate the track volumes
     void checkMaxTracks();
 
+    // Publishes a new snapshot of the song unless an update is in progress
+    void publishSnapshot();
+
 signals:
     // Emitted when the song name has changed
     void nameChanged();
@@ -235,6 +271,15 @@ signals:
     // Emitted when the tempo has changed
     void tempoChanged();
 
+    // Emitted when instruments have been added or their MIDI interface or channel has changed
+    void instrumentRoutingChanged();
+
+    // Emitted when the default velocity of an instrument has changed
+    void instrumentVelocityChanged();
+
+    // Emitted when a new snapshot of the song structure has been published
+    void snapshotChanged();
+
 private:
     // Initializes an empty song
     void init();
@@ -254,6 +299,9 @@ private:
     // Connects signals related to an instrument
     void connectInstrumentSignals(Instrument *instrument);
 
+    // Connects signals related to a message
+    void connectMessageSignals(Message *message);
+
     // Name of the song
     QString name_;
     // Tempo, ticks per line
@@ -276,8 +324,12 @@ private:
     bool sendSync_;
     // Path the song was last stored to
     QString path_;
-    // Mutex for locking the song
-    QMutex mutex;
+    // The published snapshot
+    QSharedPointer<const SongSnapshot> snapshot_;
+    // Mutex for publishing and fetching the snapshot; only held while copying the pointer
+    mutable QMutex snapshotMutex;
+    // Number of multi-step changes in progress; snapshots are published when the outermost one completes
+    int updating;
     // Whether the song has been modified since it was saved
     bool modified;
 };
@@ -3,6 +3,7 @@ OBJECTS_DIR = .obj
 
 SOURCES += main.cpp \
            block.cpp \
+           blocktimeline.cpp \
            instrument.cpp \
            message.cpp \
            playseq.cpp \
@@ -12,6 +13,11 @@ SOURCES += main.cpp \
            mainwindow.cpp \
     midi.cpp \
     midiinterface.cpp \
+    midioutputqueue.cpp \
+    midiinputqueue.cpp \
+    midithru.cpp \
+    miditracer.cpp \
+    recorder.cpp \
     preferencesdialog.cpp \
     trackvolumesdialog.cpp \
     songpropertiesdialog.cpp \
@@ -43,12 +49,16 @@ SOURCES += main.cpp \
     buffermidi.cpp \
     buffermidiinterface.cpp \
     scheduler.cpp \
+    clockfollower.cpp \
+    schedulercalibration.cpp \
+    latencyhistogram.cpp \
     schedulerrtc.cpp \
     schedulernanosleep.cpp \
     helpdialog.cpp \
     tutkadialog.cpp
 
 HEADERS += block.h \
+           blocktimeline.h \
            instrument.h \
            message.h \
            playseq.h \
@@ -58,6 +68,12 @@ HEADERS += block.h \
            mainwindow.h \
     midi.h \
     midiinterface.h \
+    midimessage.h \
+    miditracer.h \
+    recorder.h \
+    midioutputqueue.h \
+    midiinputqueue.h \
+    midithru.h \
     preferencesdialog.h \
     trackvolumesdialog.h \
     songpropertiesdialog.h \
@@ -89,6 +105,9 @@ HEADERS += block.h \
     buffermidi.h \
     buffermidiinterface.h \
     scheduler.h \
+    clockfollower.h \
+    schedulercalibration.h \
+    latencyhistogram.h \
     schedulerrtc.h \
     schedulernanosleep.h \
     helpdialog.h \
@@ -124,8 +143,8 @@ lrelease.output        = ${QMAKE_FILE_BASE}.qm
 lrelease.commands      = lrelease ${QMAKE_FILE_IN} -qm ${QMAKE_FILE_BASE}.qm
 lrelease.CONFIG       += no_link target_predeps
 
-unix:!macx:SOURCES += alsamidi.cpp alsamidiinterface.cpp
-unix:!macx:HEADERS += alsamidi.h alsamidiinterface.h
+unix:!macx:SOURCES += alsamidi.cpp alsamidiinterface.cpp schedulermonotonic.cpp schedulerreactor.cpp schedulerhybrid.cpp
+unix:!macx:HEADERS += alsamidi.h alsamidiinterface.h schedulermonotonic.h schedulerreactor.h schedulerhybrid.h
 unix:!macx:LIBS += -lasound
 
 macx:SOURCES += coremidi.cpp coremidiinterface.cpp